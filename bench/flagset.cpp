@@ -0,0 +1,115 @@
+#!/usr/bin/env hbcxx
+//#! -O2
+
+/*
+ * flagset.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file flagset.cpp
+ *
+ * Benchmark for FlagSet.
+ *
+ * Pushes groups of flags resembling pkg-config output (many of them
+ * repeated, as happens when several units require the same packages) and
+ * compares FlagSet with the std::list and std::search approach it replaced.
+ *
+ * Usage: bench/flagset.cpp [groups]
+ */
+
+#include "../src/FlagSet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+typedef std::vector<std::list<std::string>> Groups;
+
+static Groups generate(unsigned count)
+{
+    auto groups = Groups{};
+
+    // every fourth group repeats an earlier one
+    for (unsigned i=0; i<count; i++) {
+	auto n = (i % 4 == 3) ? i / 2 : i;
+	groups.push_back({ "-I/usr/include/pkg" + std::to_string(n),
+	                   "-DPKG_" + std::to_string(n) + "=1",
+	                   "-L/usr/lib/pkg" + std::to_string(n),
+	                   "-lpkg" + std::to_string(n) });
+    }
+
+    return groups;
+}
+
+static std::size_t pushWithList(const Groups& groups)
+{
+    auto flags = std::list<std::string>{};
+
+    for (auto& group : groups)
+	if (std::search(flags.begin(), flags.end(), group.begin(), group.end())
+	    == flags.end())
+	    flags.insert(flags.end(), group.begin(), group.end());
+
+    return flags.size();
+}
+
+static std::size_t pushWithFlagSet(const Groups& groups)
+{
+    auto flags = FlagSet{};
+
+    for (auto& group : groups)
+	if (!flags.contains(group))
+	    for (auto& flag : group)
+		flags.pushBack(flag);
+
+    return flags.size();
+}
+
+template <typename Push>
+static void measure(const char* name, const Groups& groups, Push push)
+{
+    auto iterations = 0u;
+    auto size = std::size_t{0};
+    auto start = chrono::steady_clock::now();
+    auto elapsed = chrono::duration<double>{};
+
+    // run for at least half a second to get a stable figure
+    do {
+	size = push(groups);
+	iterations++;
+	elapsed = chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.5);
+
+    auto us = elapsed.count() * 1e6 / iterations;
+    std::cout << std::setw(8) << name << ": "
+              << std::fixed << std::setprecision(1) << std::setw(10) << us
+              << " us per run (" << size << " flags)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    auto count = argc > 1 ? unsigned(std::atoi(argv[1])) : 2000u;
+    auto groups = generate(count);
+
+    std::cout << "groups: " << groups.size() << " (4 flags each)\n";
+    measure("list", groups, pushWithList);
+    measure("flagset", groups, pushWithFlagSet);
+
+    return 0;
+}
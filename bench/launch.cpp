@@ -0,0 +1,349 @@
+#!/usr/bin/env hbcxx
+//#! -O2
+
+/*
+ * launch.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file launch.cpp
+ *
+ * Launch latency benchmark for hbcxx.
+ *
+ * Generates a synthetic program with the requested number of units,
+ * shared headers and hash bang directives then measures how long the hbcxx
+ * found on the PATH takes to launch it:
+ *
+ *  - cold: with an empty store (apart from the toolchain) and no ccache,
+ *  - ccache: with an empty store but a warm ccache (skipped if ccache is
+ *    not installed),
+ *  - cached: with the executable already in the store.
+ *
+ * The pre-pre-processor throughput is taken from the --hbcxx-trace output
+ * of the cold runs. Results are written to stdout as one JSON object per
+ * line so that they can be compared between releases.
+ *
+ * Usage: bench/launch.cpp [--units=N] [--headers=M] [--directives=K]
+ *                         [--lines=L] [--runs=R]
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace chrono = std::chrono;
+namespace file = boost::filesystem;
+
+struct Parameters {
+    unsigned units;
+    unsigned headers;
+    unsigned directives;
+    unsigned lines;
+    unsigned runs;
+};
+
+static void writeFile(const file::path& fname, const std::string& contents,
+                      std::size_t& bytes)
+{
+    std::ofstream out{fname.string()};
+    out << contents;
+    bytes += contents.size();
+}
+
+/*!
+ * Generate the program.
+ *
+ * Units have between half and one and a half times the requested number of
+ * lines so that the scanner sees a mix of file sizes.
+ *
+ * \returns the total size of the generated files
+ */
+static std::size_t generate(const Parameters& params, const file::path& dir)
+{
+    auto bytes = std::size_t{0};
+
+    for (auto h = 0u; h < params.headers; h++) {
+	std::ostringstream out;
+	out << "#ifndef SHARED_" << h << "_H\n"
+	    << "#define SHARED_" << h << "_H\n"
+	    << "#include <string>\n"
+	    << "#include <vector>\n"
+	    << "inline unsigned shared_" << h << "(unsigned x) { return x + "
+	    << h << "; }\n"
+	    << "#endif\n";
+	writeFile(dir / ("shared_" + std::to_string(h) + ".h"), out.str(),
+	          bytes);
+    }
+
+    for (auto u = 0u; u < params.units; u++) {
+	auto name = "unit_" + std::to_string(u);
+	writeFile(dir / (name + ".h"), "unsigned " + name + "(unsigned x);\n",
+	          bytes);
+
+	std::ostringstream out;
+	out << "#include <vector>\n"
+	    << "#include \"" << name << ".h\"\n";
+	for (auto h = 0u; h < params.headers; h++)
+	    out << "#include \"shared_" << h << ".h\"\n";
+
+	auto helpers = params.lines * (1 + u % 3) / 2;
+	for (auto i = 0u; i < helpers; i++) {
+	    out << "static unsigned helper_" << i << "(unsigned x) { return x * "
+	        << i + 1;
+	    if (params.headers)
+		out << " + shared_" << i % params.headers << "(x)";
+	    out << "; }\n";
+	}
+
+	out << "unsigned " << name << "(unsigned x)\n{\n"
+	    << "    std::vector<unsigned> v;\n";
+	for (auto i = 0u; i < helpers; i++)
+	    out << "    v.push_back(helper_" << i << "(x));\n";
+	out << "    unsigned t = 0;\n"
+	    << "    for (auto i : v) t += i;\n"
+	    << "    return t;\n}\n";
+	writeFile(dir / (name + ".cpp"), out.str(), bytes);
+    }
+
+    std::ostringstream out;
+    out << "#!/usr/bin/env hbcxx\n";
+    for (auto d = 0u; d < params.directives; d++)
+	out << "//" "#! -DBENCH_DIRECTIVE_" << d << '=' << d << '\n';
+    for (auto u = 0u; u < params.units; u++)
+	out << "#include \"unit_" << u << ".h\"\n";
+    out << "int main()\n{\n"
+        << "    unsigned t = 0;\n";
+    for (auto u = 0u; u < params.units; u++)
+	out << "    t += unit_" << u << "(" << u << ");\n";
+    out << "    return t == 1 ? 1 : 0;\n}\n";
+    writeFile(dir / "main.cpp", out.str(), bytes);
+
+    // hbcxx does not trust files modified in the last couple of seconds
+    auto past = std::time(nullptr) - 60;
+    for (auto& entry : file::directory_iterator{dir})
+	file::last_write_time(entry.path(), past);
+
+    return bytes;
+}
+
+static bool onPath(const std::string& program)
+{
+    auto path = std::getenv("PATH");
+    std::istringstream dirs{path ? path : ""};
+    for (auto dir = std::string{}; std::getline(dirs, dir, ':'); )
+	if (0 == access((file::path{dir} / program).c_str(), X_OK))
+	    return true;
+    return false;
+}
+
+/*!
+ * Run hbcxx (with the supplied environment changes) and time it.
+ *
+ * \returns the wall time in milliseconds
+ */
+static double run(const std::vector<std::string>& args,
+                  const std::vector<std::string>& env)
+{
+    auto argv = std::vector<char*>{};
+    for (auto& arg : args)
+	argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    auto start = chrono::steady_clock::now();
+    auto pid = fork();
+    if (0 == pid) {
+	for (auto& var : env)
+	    putenv(const_cast<char*>(var.c_str()));
+	auto null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	dup2(null, 2);
+	execvp(argv[0], argv.data());
+	_exit(127);
+    }
+
+    auto status = int{-1};
+    if (pid < 0 || pid != waitpid(pid, &status, 0) || 0 != status) {
+	std::cerr << "launch: failed: " << args.front() << ' ' << args.back()
+	          << '\n';
+	std::exit(1);
+    }
+
+    chrono::duration<double, std::milli> elapsed =
+	chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/*!
+ * Prepare an empty store (apart from the toolchain, which is probed once).
+ */
+static file::path makeStore(const file::path& home, const file::path& tmpl)
+{
+    file::create_directories(home / ".hbcxx");
+    auto toolchain = tmpl / ".hbcxx" / "toolchain";
+    if (file::exists(toolchain))
+	file::copy_file(toolchain, home / ".hbcxx" / "toolchain");
+    return home;
+}
+
+/*!
+ * Total the time spent pre-pre-processing from a --hbcxx-trace file.
+ *
+ * \returns the time in milliseconds
+ */
+static double getPrePreProcessTime(const file::path& trace)
+{
+    auto total = 0.0;
+    std::ifstream in{trace.string()};
+    for (auto line = std::string{}; std::getline(in, line); ) {
+	if (line.find("\"name\":\"pre-pre-process\"") == std::string::npos)
+	    continue;
+	auto dur = line.find("\"dur\":");
+	if (dur != std::string::npos)
+	    total += std::atof(line.c_str() + dur + 6) / 1000;
+    }
+    return total;
+}
+
+/*!
+ * Report the distribution of the samples (using nearest rank percentiles).
+ */
+static void report(const Parameters& params, const std::string& scenario,
+                   const std::string& unit, std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+	auto rank = std::size_t(std::ceil(p / 100 * samples.size()));
+	return samples[rank ? rank - 1 : 0];
+    };
+    auto mean = 0.0;
+    for (auto sample : samples)
+	mean += sample / samples.size();
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"benchmark\":\"launch\",\"scenario\":\"" << scenario
+              << "\",\"units\":" << params.units
+              << ",\"headers\":" << params.headers
+              << ",\"directives\":" << params.directives
+              << ",\"lines\":" << params.lines
+              << ",\"runs\":" << samples.size()
+              << ",\"unit\":\"" << unit << '"'
+              << ",\"min\":" << samples.front()
+              << ",\"p50\":" << percentile(50)
+              << ",\"p90\":" << percentile(90)
+              << ",\"p95\":" << percentile(95)
+              << ",\"p99\":" << percentile(99)
+              << ",\"max\":" << samples.back()
+              << ",\"mean\":" << mean << "}" << std::endl;
+}
+
+static void skip(const std::string& scenario, const std::string& reason)
+{
+    std::cout << "{\"benchmark\":\"launch\",\"scenario\":\"" << scenario
+              << "\",\"skipped\":\"" << reason << "\"}" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    auto params = Parameters{8, 4, 4, 100, 5};
+    for (auto i = 1; i < argc; i++) {
+	auto arg = std::string{argv[i]};
+	auto equals = arg.find('=');
+	auto name = arg.substr(0, equals);
+	auto value = equals == std::string::npos
+	                 ? 0u
+	                 : unsigned(std::atoi(arg.c_str() + equals + 1));
+	if (name == "--units" && value)
+	    params.units = value;
+	else if (name == "--headers")
+	    params.headers = value;
+	else if (name == "--directives")
+	    params.directives = value;
+	else if (name == "--lines" && value)
+	    params.lines = value;
+	else if (name == "--runs" && value)
+	    params.runs = value;
+	else {
+	    std::cerr << "Usage: " << argv[0] << " [--units=N] [--headers=M] "
+	              << "[--directives=K] [--lines=L] [--runs=R]\n";
+	    return 1;
+	}
+    }
+
+    auto root = file::temp_directory_path() / file::unique_path();
+    auto src = root / "src";
+    file::create_directories(src);
+    auto bytes = generate(params, src);
+    auto main = (src / "main.cpp").string();
+
+    // the first launch probes the toolchain and fills the store used by
+    // the cached runs
+    auto tmpl = root / "template";
+    file::create_directories(tmpl);
+    run({"hbcxx", main}, {"HOME=" + tmpl.string(), "CCACHE_DISABLE=1"});
+
+    auto cold = std::vector<double>{};
+    auto ppp = std::vector<double>{};
+    for (auto i = 0u; i < params.runs; i++) {
+	auto home = makeStore(root / ("cold-" + std::to_string(i)), tmpl);
+	auto trace = home / "trace.json";
+	cold.push_back(run({"hbcxx", "--hbcxx-trace=" + trace.string(), main},
+	                   {"HOME=" + home.string(), "CCACHE_DISABLE=1"}));
+	auto ms = getPrePreProcessTime(trace);
+	if (ms > 0)
+	    ppp.push_back(bytes / 1e3 / ms); // MB/s
+    }
+    report(params, "cold", "ms", cold);
+
+    if (onPath("ccache")) {
+	auto ccacheDir = "CCACHE_DIR=" + (root / "ccache").string();
+	auto primer = makeStore(root / "ccache-primer", tmpl);
+	run({"hbcxx", main}, {"HOME=" + primer.string(), ccacheDir});
+
+	auto warm = std::vector<double>{};
+	for (auto i = 0u; i < params.runs; i++) {
+	    auto home = makeStore(root / ("ccache-" + std::to_string(i)), tmpl);
+	    warm.push_back(run({"hbcxx", main},
+	                       {"HOME=" + home.string(), ccacheDir}));
+	}
+	report(params, "ccache", "ms", warm);
+    } else {
+	skip("ccache", "ccache not found");
+    }
+
+    auto cached = std::vector<double>{};
+    for (auto i = 0u; i < params.runs; i++)
+	cached.push_back(run({"hbcxx", main}, {"HOME=" + tmpl.string()}));
+    report(params, "cached", "ms", cached);
+
+    if (ppp.empty())
+	skip("ppp", "no pre-pre-processor spans in trace");
+    else
+	report(params, "ppp", "MB/s", ppp);
+
+    file::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#!/usr/bin/env hbcxx
+//#! -O2
+
+/*
+ * scanner.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file scanner.cpp
+ *
+ * Throughput benchmark for DirectiveScanner.
+ *
+ * Generates a synthetic source file (or reads the files named on the
+ * command line) and compares the scanner with the regular expression
+ * cascade it replaced.
+ *
+ * Usage: bench/scanner.cpp [file...]
+ */
+
+#include "../src/DirectiveScanner.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <boost/regex.hpp>
+
+namespace chrono = std::chrono;
+namespace re = boost;
+
+static std::string generate(unsigned lines)
+{
+    std::ostringstream out;
+
+    out << "#!/usr/bin/env hbcxx\n"
+        << "//" "#! -O2\n"
+        << "#include <vector>\n"
+        << "#include \"local.h\"\n";
+    for (unsigned i=0; i<lines; i++) {
+	switch (i % 8) {
+	case 0:
+	    out << "#define VALUE_" << i << " " << i << '\n';
+	    break;
+	case 1:
+	    out << "    // a comment that does not contain a hash\n";
+	    break;
+	default:
+	    out << "    value += compute(" << i << ", \"string\");\n";
+	    break;
+	}
+    }
+
+    return out.str();
+}
+
+static unsigned scanWithRegex(const std::string& buffer)
+{
+    auto rawHashBangRegex = re::regex{"^([ \t]*)(#!)"};
+    auto hashBangRegex = re::regex{"^(.*)//#![ \t]*(.*)$"};
+    auto interpreterRegex = re::regex{"//#![ \t]*/"};
+    auto flagsRegex = re::regex{"//#![ \t]*(-.*)$"};
+    auto directiveRegex = re::regex{"//#![ \t]*([a-zA-Z_]*)[ \t]*:[ \t]*(.*)$"};
+    auto localIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*\"([^\"]*)\""};
+    auto systemIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*<([^\"]*)>"};
+
+    std::istringstream in{buffer};
+    auto origline = std::string{};
+    auto match = re::smatch{};
+    auto found = 0u;
+
+    while (std::getline(in, origline)) {
+	auto line = re::regex_replace(origline, rawHashBangRegex, "$1//$2");
+	if (re::regex_search(line, match, hashBangRegex)) {
+	    found += re::regex_search(line, match, flagsRegex);
+	    found += re::regex_search(line, match, directiveRegex);
+	    found += re::regex_search(line, interpreterRegex);
+	}
+	found += re::regex_search(line, match, localIncludeRegex);
+	found += re::regex_search(line, match, systemIncludeRegex);
+    }
+
+    return found;
+}
+
+static unsigned scanWithScanner(const std::string& buffer)
+{
+    DirectiveScanner scanner{buffer.data(), buffer.data() + buffer.size()};
+    auto line = ScannedLine{};
+    auto found = 0u;
+
+    while (scanner.next(line)) {
+	if (line.hasHashBang)
+	    found += line.hasFlags + line.hasDirective + line.hasInterpreter;
+	found += line.include != ScannedLine::NoInclude;
+    }
+
+    return found;
+}
+
+template <typename Scan>
+static void measure(const char* name, const std::string& buffer, Scan scan)
+{
+    auto iterations = 0u;
+    auto found = 0u;
+    auto start = chrono::steady_clock::now();
+    auto elapsed = chrono::duration<double>{};
+
+    // run for at least half a second to get a stable figure
+    do {
+	found = scan(buffer);
+	iterations++;
+	elapsed = chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.5);
+
+    auto mbps = (double(buffer.size()) * iterations) / elapsed.count() / 1e6;
+    std::cout << std::setw(8) << name << ": "
+              << std::fixed << std::setprecision(1) << std::setw(8) << mbps
+              << " MB/s (" << found << " matches)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    auto buffer = std::string{};
+
+    if (argc > 1) {
+	for (int i=1; i<argc; i++) {
+	    std::ifstream in{argv[i], std::ios::binary};
+	    buffer.append(std::istreambuf_iterator<char>{in},
+	                  std::istreambuf_iterator<char>{});
+	}
+    } else {
+	buffer = generate(50000);
+    }
+
+    std::cout << "input: " << buffer.size() << " bytes\n";
+    measure("regex", buffer, scanWithRegex);
+    measure("scanner", buffer, scanWithScanner);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * BenchLauncher.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "BenchLauncher.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "system.h"
+#include "util.h"
+#include "Options.h"
+
+namespace chrono = std::chrono;
+
+BenchLauncher::BenchLauncher(unsigned runs, unsigned warmup)
+    : _runs{runs}
+    , _warmup{warmup}
+{
+}
+
+/*!
+ * Get the CPU time (user and system) used by the children reaped so far.
+ */
+static double getChildrenCpuTime()
+{
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_CHILDREN, &usage))
+	return 0;
+
+    auto ms = [](const struct timeval& tv) {
+	return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+    };
+    return ms(usage.ru_utime) + ms(usage.ru_stime);
+}
+
+/*!
+ * Pin hbcxx (and therefore the executable it runs) to a single CPU.
+ */
+static void pinToCpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu < CPU_SETSIZE) {
+	CPU_SET(cpu, &set);
+	if (0 == sched_setaffinity(0, sizeof(set), &set))
+	    return;
+    }
+#endif
+
+    std::cerr << "hbcxx: warning: cannot pin benchmark to CPU " << cpu
+              << '\n';
+}
+
+int BenchLauncher::launch(const CompilationUnit& unit,
+                          const std::list<std::string>& args)
+{
+    auto executable = unit.getExecutableFileName();
+    auto fullArgs = args;
+    fullArgs.push_front(unit.getInputFileName());
+
+    // the same input is replayed for every run (by rewinding the file
+    // rather than copying it through a pipe)
+    auto input = int{-1};
+    if (!Options::benchInput().empty()) {
+	input = ::open(Options::benchInput().c_str(), O_RDONLY | O_CLOEXEC);
+	if (-1 == input) {
+	    std::cerr << "hbcxx: cannot read benchmark input: "
+	              << Options::benchInput() << '\n';
+	    return W_EXITCODE(1, 0);
+	}
+    }
+    hbcxx::ScopeExit closeInput{[input] {
+	if (-1 != input)
+	    (void) ::close(input);
+    }};
+
+    if (Options::benchCpu() >= 0)
+	pinToCpu(Options::benchCpu());
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: benchmarking " << executable << " ("
+	          << _warmup << " warmup runs, " << _runs << " runs)\n";
+
+    hbcxx::block_signals();
+
+    auto wall = std::vector<double>{};
+    auto cpu = std::vector<double>{};
+    for (auto i = 0u; i < _warmup + _runs; i++) {
+	auto startCpu = getChildrenCpuTime();
+	auto start = chrono::steady_clock::now();
+
+	if (-1 != input)
+	    (void) ::lseek(input, 0, SEEK_SET);
+
+	auto res = int{-1};
+	auto pid = hbcxx::spawn(executable, fullArgs, input);
+	if (pid < 0 || pid != hbcxx::reap(pid, res))
+	    res = W_EXITCODE(127, 0);
+
+	chrono::duration<double, std::milli> elapsed =
+	    chrono::steady_clock::now() - start;
+	hbcxx::poll_signals();
+
+	// there is no point timing a program that does not work
+	if (0 != res) {
+	    std::cerr << "hbcxx: benchmark run " << i + 1 << " failed\n";
+	    return res;
+	}
+
+	if (i < _warmup)
+	    continue;
+	wall.push_back(elapsed.count());
+	cpu.push_back(getChildrenCpuTime() - startCpu);
+    }
+
+    std::cerr << "hbcxx: bench: " << _runs << " runs of "
+              << unit.getInputFileName() << " (" << _warmup
+              << " warmup runs)\n"
+              << "hbcxx: bench:       " << std::right
+              << std::setw(11) << "min" << std::setw(11) << "median"
+              << std::setw(11) << "mean" << std::setw(11) << "stddev"
+              << std::setw(11) << "p95" << '\n';
+    report("wall ms", wall);
+    report("cpu ms", cpu);
+
+    return 0;
+}
+
+void BenchLauncher::report(const std::string& name,
+                           std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    auto n = samples.size();
+
+    auto mean = 0.0;
+    for (auto sample : samples)
+	mean += sample / n;
+
+    auto variance = 0.0;
+    for (auto sample : samples)
+	variance += (sample - mean) * (sample - mean);
+    auto stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0.0;
+
+    auto median = n % 2 ? samples[n / 2]
+                        : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+    // nearest rank
+    auto rank = std::size_t(std::ceil(0.95 * n));
+    auto p95 = samples[rank ? rank - 1 : 0];
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3) << "hbcxx: bench: "
+         << std::left << std::setw(7) << name << std::right
+         << std::setw(11) << samples.front() << std::setw(11) << median
+         << std::setw(11) << mean << std::setw(11) << stddev
+         << std::setw(11) << p95 << '\n';
+    std::cerr << line.str();
+}
@@ -0,0 +1,43 @@
+/*
+ * BenchLauncher.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_BENCH_LAUNCHER_H_
+#define HBCXX_BENCH_LAUNCHER_H_
+
+#include <vector>
+
+#include "Launcher.h"
+
+/*!
+ * Run the executable repeatedly and report how long it took.
+ *
+ * Selected by --hbcxx-bench=N. The executable is run N times (after any
+ * warmup runs, whose times are discarded) and the wall and CPU time of the
+ * runs is summarized on stderr.
+ */
+class BenchLauncher : public Launcher {
+public:
+    BenchLauncher(unsigned runs, unsigned warmup);
+    virtual ~BenchLauncher() override {};
+
+    virtual int launch(const CompilationUnit& unit,
+                        const std::list<std::string>& args) override;
+
+private:
+    static void report(const std::string& name, std::vector<double> samples);
+
+    unsigned _runs;
+    unsigned _warmup;
+};
+
+#endif // HBCXX_BENCH_LAUNCHER_H_
@@ -0,0 +1,100 @@
+/*
+ * BuildLock.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "BuildLock.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include "system.h"
+#include "Options.h"
+
+namespace file = boost::filesystem;
+
+BuildLock::BuildLock(const std::string& fname)
+    : _fileName{fname}
+    , _fd{-1}
+    , _hasWaited{false}
+{
+    if (!_fileName.empty())
+	acquire();
+}
+
+BuildLock::~BuildLock()
+{
+    release();
+}
+
+bool BuildLock::hasWaited() const
+{
+    return _hasWaited;
+}
+
+void BuildLock::release()
+{
+    if (-1 == _fd)
+	return;
+
+    // closing the file releases the lock
+    (void) ::close(_fd);
+    _fd = -1;
+}
+
+void BuildLock::acquire()
+{
+    auto verbose = Options::verbose();
+    auto ec = boost::system::error_code{};
+    file::create_directories(file::path{_fileName}.parent_path(), ec);
+
+    // the lock must not be inherited by the compiler or the program
+    auto fd = ::open(_fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (-1 != fd && 0 != ::flock(fd, LOCK_EX | LOCK_NB)) {
+	auto locked = false;
+	if (errno == EWOULDBLOCK) {
+	    if (verbose)
+		std::cerr << "hbcxx: waiting for build lock: " << _fileName
+		          << '\n';
+	    _hasWaited = true;
+
+	    for (;;) {
+		if (0 == ::flock(fd, LOCK_EX)) {
+		    locked = true;
+		    break;
+		}
+		if (errno != EINTR)
+		    break;
+		hbcxx::poll_signals();
+	    }
+	}
+
+	// build without the lock if the filesystem cannot support it
+	if (!locked) {
+	    (void) ::close(fd);
+	    fd = -1;
+	}
+    }
+
+    if (-1 != fd) {
+	_fd = fd;
+	return;
+    }
+
+    if (verbose)
+	std::cerr << "hbcxx: building without lock: " << _fileName << '\n';
+}
@@ -0,0 +1,68 @@
+/*
+ * BuildLock.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_BUILD_LOCK_H_
+#define HBCXX_BUILD_LOCK_H_
+
+#include <string>
+
+/*!
+ * Exclusive lock held whilst a program is being built.
+ *
+ * When the same program is started many times at once only the first
+ * invocation builds it. The others wait for the lock and can then launch
+ * the executable the first one cached.
+ *
+ * The lock is an flock() on a file and is therefore released by the kernel
+ * if the builder is killed (the descriptor is close-on-exec so it cannot be
+ * inherited by the compiler or the program). There is no such thing as a
+ * stale lock, so waiters simply block until the lock is released.
+ *
+ * Locking is an optimization rather than a requirement (everything hbcxx
+ * shares between invocations is published atomically) so if the lock
+ * cannot be taken, for example because the filesystem does not support
+ * flock(), we build without it.
+ */
+class BuildLock {
+public:
+    /*!
+     * Acquire the lock, waiting for any other builder to finish.
+     *
+     * SIGINT and SIGQUIT must not be blocked (see hbcxx::block_signals())
+     * since they are the only way to interrupt the wait.
+     *
+     * \param fname name of the lock file (or empty to do nothing)
+     */
+    explicit BuildLock(const std::string& fname);
+    ~BuildLock();
+
+    /*!
+     * Check whether another invocation held the lock when we tried to
+     * acquire it (in which case it might have built the program for us).
+     */
+    bool hasWaited() const;
+
+    void release();
+
+private:
+    BuildLock(const BuildLock&);
+    BuildLock& operator=(const BuildLock&);
+
+    void acquire();
+
+    std::string _fileName;
+    int _fd;
+    bool _hasWaited;
+};
+
+#endif // HBCXX_BUILD_LOCK_H_
@@ -13,22 +13,22 @@
 
 #include "CompilationUnit.h"
 
+#include <cstdio>
 #include <fstream>
+#include <iostream>
 #include <utility>
 
 #include <boost/filesystem.hpp>
 
 #include "filesystem.h"
+#include "hash.h"
 #include "string.h"
 #include "system.h"
 #include "util.h"
 #include "Options.h"
 #include "PrePreProcessor.h"
 
-using hbcxx::make_unique;
 using hbcxx::shlex;
-using std::begin;
-using std::end;
 namespace file = boost::filesystem;
 
 /*!
@@ -62,44 +62,71 @@ static file::path makeWriteable(const file::path& path)
     throw PrePreProcessorError{};
 }
 
-CompilationUnit::CompilationUnit(const CompilationUnit& that)
-    : _hasProcessedFile{that._hasProcessedFile}
-    , _hasObjectFile{that._hasObjectFile}
-    , _isHeader{that._isHeader}
-    , _originalFileName{that._originalFileName}
-    , _processedFileName{that._processedFileName}
-    , _flags{that._flags}
-    , _privateFlags{that._privateFlags}
+/*!
+ * Get the directory used for files that can be shared between runs.
+ */
+static file::path getBuildDirectory()
 {
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	throw PrePreProcessorError{};
+
+    auto dir = file::path{store} / "build";
+    auto ec = boost::system::error_code{};
+    (void) file::create_directories(dir, ec);
+    return dir;
+}
+
+/*!
+ * Get a file extension the compiler will recognise as C++.
+ */
+static std::string getSourceExtension(const file::path& original)
+{
+    auto extension = original.extension().string();
+    for (auto sourceExtension : {".cpp", ".c++", ".C", ".cc", ".c"})
+        if (extension == sourceExtension)
+	    return extension;
+
+    return ".cpp";
 }
 
 CompilationUnit::CompilationUnit(std::string fname, FileType type)
     : _hasProcessedFile{false}
     , _hasObjectFile{false}
     , _isHeader{type == HeaderFile}
+    , _isMerged{false}
+    , _hasLocalIncludes{false}
+    , _compileTime{0}
     , _originalFileName{fname}
     , _processedFileName{}
+    , _objectFileName{}
+    , _executableFileName{}
+    , _rewrites{}
     , _flags{}
     , _privateFlags{}
+    , _leadingIncludes{}
 {
-    auto unique = hbcxx::unique();
-    auto original = file::path{fname};
-    auto parent = original.parent_path();
-    auto candidate = file::path{_originalFileName + unique + ".cpp"};
-
-    // improve the candidate file name if needed
-    auto extension = original.extension();
-    for (auto sourceExtension : {".cpp", ".c++", ".C", ".cc", ".c"}) {
-        if (extension == sourceExtension) {
-            auto filename = parent / original.stem();
-            filename += unique;
-            filename += extension;
-	    candidate = filename;
-	    break;
-        }
-    }
+}
 
-    _processedFileName = candidate.string();
+CompilationUnit::CompilationUnit(CompilationUnit&& that)
+    : _hasProcessedFile{that._hasProcessedFile}
+    , _hasObjectFile{that._hasObjectFile}
+    , _isHeader{that._isHeader}
+    , _isMerged{that._isMerged}
+    , _hasLocalIncludes{that._hasLocalIncludes}
+    , _compileTime{that._compileTime}
+    , _originalFileName{std::move(that._originalFileName)}
+    , _processedFileName{std::move(that._processedFileName)}
+    , _objectFileName{std::move(that._objectFileName)}
+    , _executableFileName{std::move(that._executableFileName)}
+    , _rewrites{std::move(that._rewrites)}
+    , _flags{std::move(that._flags)}
+    , _privateFlags{std::move(that._privateFlags)}
+    , _leadingIncludes{std::move(that._leadingIncludes)}
+{
+    // the temporary files now belong to the new unit
+    that._hasProcessedFile = false;
+    that._hasObjectFile = false;
 }
 
 CompilationUnit::~CompilationUnit()
@@ -111,25 +138,73 @@ std::string CompilationUnit::getInputFileName() const
     return _originalFileName;
 }
 
-std::unique_ptr<std::ofstream> CompilationUnit::openProcessedFile()
+void CompilationUnit::setRewrites(std::vector<std::size_t> offsets)
 {
-    auto filename = makeWriteable(_processedFileName);
+    _rewrites = std::move(offsets);
+}
+
+bool CompilationUnit::needsRewrite() const
+{
+    return !_rewrites.empty();
+}
+
+ProcessedSource CompilationUnit::getProcessedSource() const
+{
+    auto source = ProcessedSource{};
+    if (!source.open(_originalFileName, _rewrites))
+	throw PrePreProcessorError{};
+    return source;
+}
+
+std::string CompilationUnit::writeProcessedFile()
+{
+    if (_hasProcessedFile)
+	return _processedFileName;
 
     if (_isHeader)
 	throw PrePreProcessorError{};
 
-    if (filename != _processedFileName) {
-	// if we are forced to compile from a different directory then we must
-	// use -iquote to ensure relative paths to #include directives work as
-        // expected.
-	auto original = file::path{_originalFileName};
-        pushPrivateFlags(std::string{"-iquote"}
-                         + original.parent_path().string());
-        _processedFileName = filename.string();
-    }
+    auto source = getProcessedSource();
+    auto original = file::path{_originalFileName};
+
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{"hbcxx-processed-1"});
+    hash.update(getCanonicalName());
+    source.updateHash(hash);
+
+    auto filename = getBuildDirectory() / original.stem();
+    filename += "-";
+    filename += hash.hex();
+    filename += getSourceExtension(original);
+    _processedFileName = filename.string();
 
+    // the processed file is not in the same directory as the original so
+    // we must use -iquote to ensure relative paths to #include directives
+    // work as expected. The directory is pushed as a token of its own
+    // (rather than lexed by pushPrivateFlags()) so it may contain spaces.
+    auto parent = original.parent_path();
+    _privateFlags.pushBack("-iquote");
+    _privateFlags.pushBack(parent.empty() ? std::string{"."}
+                                          : parent.string());
+
+    // the name is derived from the contents so an existing file can be
+    // reused (and must not be truncated since another process could be
+    // compiling it)
+    auto st = hbcxx::FileStamp{};
+    if (!hbcxx::stamp(_processedFileName, st) || st.size != source.size()) {
+	if (!source.writeFile(_processedFileName))
+	    throw PrePreProcessorError{};
+    } else {
+	// keep the garbage collector away from a file we are about to use
+	hbcxx::markAccessed(_processedFileName);
+    }
     _hasProcessedFile = true;
-    return make_unique<std::ofstream>(_processedFileName);
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: wrote pre-pre-processor output to: "
+	          << _processedFileName << '\n';
+
+    return _processedFileName;
 }
 
 std::string CompilationUnit::getProcessedFileName() const
@@ -142,16 +217,66 @@ std::string CompilationUnit::getProcessedFileName() const
     return _processedFileName;
 }
 
-std::string CompilationUnit::getObjectFileName()
+std::string CompilationUnit::getCanonicalName() const
+{
+    auto ec = boost::system::error_code{};
+    auto canonical = file::canonical(_originalFileName, ec);
+    if (ec)
+	return file::absolute(_originalFileName).string();
+    return canonical.string();
+}
+
+void CompilationUnit::setObjectKey(const std::string& key)
 {
     if (_isHeader)
 	throw PrePreProcessorError{};
 
-    auto processed = file::path{_processedFileName};
-    auto filename = processed.parent_path() / processed.stem();
+    auto filename = getBuildDirectory()
+                    / file::path{_originalFileName}.stem();
+    filename += "-";
+    filename += key;
     filename += ".o";
-    _hasObjectFile = true;
-    return makeWriteable(filename).string();
+    _objectFileName = filename.string();
+}
+
+std::string CompilationUnit::getObjectFileName() const
+{
+    if (_isHeader || _objectFileName.empty())
+	throw PrePreProcessorError{};
+
+    return _objectFileName;
+}
+
+std::string CompilationUnit::getObjectOutputFileName() const
+{
+    return getObjectFileName() + hbcxx::unique();
+}
+
+void CompilationUnit::setObjectPending(bool pending)
+{
+    _hasObjectFile = pending;
+}
+
+void CompilationUnit::setCompileTime(std::uint64_t startTime)
+{
+    _compileTime = startTime;
+}
+
+std::uint64_t CompilationUnit::getCompileTime() const
+{
+    return _compileTime;
+}
+
+bool CompilationUnit::publishObjectFile()
+{
+    if (!_hasObjectFile)
+	return false;
+
+    auto output = getObjectOutputFileName();
+    if (0 != std::rename(output.c_str(), _objectFileName.c_str()))
+	throw PrePreProcessorError{};
+    _hasObjectFile = false;
+    return true;
 }
 
 std::string CompilationUnit::getExecutableFileName() const
@@ -163,12 +288,23 @@ std::string CompilationUnit::getExecutableFileName() const
     if (!executable.empty())
 	return executable;
 
-    auto processed = file::path{_processedFileName};
-    auto filename = processed.parent_path() / processed.stem();
+    if (!_executableFileName.empty())
+	return _executableFileName;
+
+    // executables are removed after they have run so, unlike the other
+    // files, they must be private to the current process
+    auto original = file::path{_originalFileName};
+    auto filename = original.parent_path() / original.stem();
+    filename += hbcxx::unique();
     filename += ".exe";
     return makeWriteable(filename).string();
 }
 
+void CompilationUnit::setExecutableFileName(std::string fname)
+{
+    _executableFileName = std::move(fname);
+}
+
 void CompilationUnit::removeTemporaryFiles()
 {
     if (Options::saveTemps())
@@ -180,13 +316,17 @@ void CompilationUnit::removeTemporaryFiles()
 		std::cerr << "hbcxx: removed " << fname << '\n';
     };
 
-    if (_hasProcessedFile)
-	remove(getProcessedFileName());
-    if (_hasObjectFile)
-	remove(getObjectFileName());
+    // processed files and published object files are named after their
+    // contents and might be in use by another process so only unpublished
+    // objects are removed
+    if (_hasObjectFile) {
+	remove(getObjectOutputFileName());
+	remove(getObjectOutputFileName() + ".d");
+	_hasObjectFile = false;
+    }
 }
 
-const std::list<std::string>& CompilationUnit::getFlags() const
+const FlagSet& CompilationUnit::getFlags() const
 {
     return _flags;
 }
@@ -201,6 +341,26 @@ void CompilationUnit::setIsHeader(bool isHeader)
 	_isHeader = isHeader;
 }
 
+bool CompilationUnit::getIsMerged() const
+{
+	return _isMerged;
+}
+
+void CompilationUnit::setIsMerged(bool isMerged)
+{
+	_isMerged = isMerged;
+}
+
+bool CompilationUnit::getHasLocalIncludes() const
+{
+	return _hasLocalIncludes;
+}
+
+void CompilationUnit::setHasLocalIncludes(bool hasLocalIncludes)
+{
+	_hasLocalIncludes = hasLocalIncludes;
+}
+
 void CompilationUnit::pushFlags(std::string flags)
 {
     auto newFlags = shlex(flags);
@@ -208,13 +368,12 @@ void CompilationUnit::pushFlags(std::string flags)
     // if the new flags contain anything new then we push the whole
     // lot (this is needed because we are running with a single pass
     // linker)
-    if (std::search(begin(_flags), end(_flags),
-		    begin(newFlags), end(newFlags)) == end(_flags))
+    if (!_flags.contains(newFlags))
         for (auto& flag : newFlags)
-            _flags.push_back(std::move(flag));
+            _flags.pushBack(std::move(flag));
 }
 
-const std::list<std::string>& CompilationUnit::getPrivateFlags() const
+const FlagSet& CompilationUnit::getPrivateFlags() const
 {
     return _privateFlags;
 }
@@ -226,8 +385,17 @@ void CompilationUnit::pushPrivateFlags(std::string flags)
     // if the new flags contain anything new then we push the whole
     // lot (this is needed because we are running with a single pass
     // linker)
-    if (std::search(begin(_flags), end(_flags),
-		    begin(newFlags), end(newFlags)) == end(_flags))
+    if (!_flags.contains(newFlags))
         for (auto& flag : newFlags)
-            _privateFlags.push_back(std::move(flag));
+            _privateFlags.pushBack(std::move(flag));
+}
+
+const std::vector<std::string>& CompilationUnit::getLeadingIncludes() const
+{
+    return _leadingIncludes;
+}
+
+void CompilationUnit::pushLeadingInclude(std::string header)
+{
+    _leadingIncludes.push_back(std::move(header));
 }
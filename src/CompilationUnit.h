@@ -14,44 +14,152 @@
 #ifndef HBCXX_COMPILATION_UNIT_H_
 #define HBCXX_COMPILATION_UNIT_H_
 
+#include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
+#include "FlagSet.h"
+#include "ProcessedSource.h"
+
 class CompilationUnit {
 public:
     enum FileType { SourceFile, HeaderFile }; // used as named arguments
 
-    CompilationUnit(const CompilationUnit& that);
     CompilationUnit(std::string fname, FileType type=SourceFile);
+    CompilationUnit(CompilationUnit&& that);
     ~CompilationUnit();
 
     std::string getInputFileName() const;
-    std::unique_ptr<std::ofstream> openProcessedFile();
+
+    /*!
+     * Record where the pre-pre-processor must insert "//" to comment out
+     * a #! line.
+     *
+     * \param offsets byte offsets into the input file (in ascending order)
+     */
+    void setRewrites(std::vector<std::size_t> offsets);
+    bool needsRewrite() const;
+
+    /*!
+     * Describe the rewritten source, starting with a #line marker.
+     */
+    ProcessedSource getProcessedSource() const;
+
+    /*!
+     * Write the rewritten source to disk (if it has not been already).
+     *
+     * The file is written to the build directory and is named after the
+     * original file and the rewritten source. Concurrent invocations that
+     * write the same source therefore share the file (which is written
+     * atomically and never removed by a run that might be sharing it).
+     *
+     * \returns the name of the processed file
+     */
+    std::string writeProcessedFile();
     std::string getProcessedFileName() const;
-    std::string getObjectFileName();
+
+    /*!
+     * Name the object file after everything that affects its contents.
+     *
+     * \param key hash of the compile command and the source file
+     */
+    void setObjectKey(const std::string& key);
+
+    /*!
+     * Get the name of the (published) object file.
+     */
+    std::string getObjectFileName() const;
+
+    /*!
+     * Get the name the compiler must write the object file to.
+     *
+     * This is private to the current process. publishObjectFile() must be
+     * called once the compiler has finished.
+     */
+    std::string getObjectOutputFileName() const;
+
+    /*!
+     * Record whether the compiler is writing a new object file.
+     */
+    void setObjectPending(bool pending);
+
+    /*!
+     * Record when the compiler was started (or a time shortly before it
+     * was started), see DependencyDatabase::record().
+     */
+    void setCompileTime(std::uint64_t startTime);
+    std::uint64_t getCompileTime() const;
+
+    /*!
+     * Atomically rename the compiler output to the object file name.
+     *
+     * \returns true if a new object file was published (false if the
+     *          existing object file was reused)
+     */
+    bool publishObjectFile();
+
     std::string getExecutableFileName() const;
+    void setExecutableFileName(std::string fname);
 
     bool getIsHeader() const;
     void setIsHeader(bool isHeader);
 
+    /*!
+     * Record whether the unit is compiled as part of a unity build (in
+     * which case it has no object file of its own).
+     */
+    bool getIsMerged() const;
+    void setIsMerged(bool isMerged);
+
+    /*!
+     * Record whether the unit has any #include "..." directives (which
+     * the compiler resolves relative to the directory of the file it is
+     * reading).
+     */
+    bool getHasLocalIncludes() const;
+    void setHasLocalIncludes(bool hasLocalIncludes);
+
     void removeTemporaryFiles();
 
-    const std::list<std::string>& getFlags() const;
+    const FlagSet& getFlags() const;
     void pushFlags(std::string flags);
 
-    const std::list<std::string>& getPrivateFlags() const;
+    const FlagSet& getPrivateFlags() const;
     void pushPrivateFlags(std::string flags);
 
+    /*!
+     * System headers included before anything else in the unit.
+     *
+     * These are candidates for precompilation since nothing in the unit
+     * can influence how they are parsed.
+     */
+    const std::vector<std::string>& getLeadingIncludes() const;
+    void pushLeadingInclude(std::string header);
+
 private:
+    // units own temporary files so they can be moved but not copied
+    CompilationUnit(const CompilationUnit&);
+    CompilationUnit& operator=(const CompilationUnit&);
+
+    std::string getCanonicalName() const;
+
     bool _hasProcessedFile;
     bool _hasObjectFile;
     bool _isHeader;
+    bool _isMerged;
+    bool _hasLocalIncludes;
+    std::uint64_t _compileTime;
     std::string _originalFileName;
     std::string _processedFileName;
-    std::list<std::string> _flags;
-    std::list<std::string> _privateFlags;
+    std::string _objectFileName;
+    std::string _executableFileName;
+    std::vector<std::size_t> _rewrites;
+    FlagSet _flags;
+    FlagSet _privateFlags;
+    std::vector<std::string> _leadingIncludes;
 };
 
 #endif // HBCXX_COMPILATION_UNIT_H_
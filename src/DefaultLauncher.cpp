@@ -20,6 +20,30 @@
 
 int DefaultLauncher::launch(const CompilationUnit& unit,
                              const std::list<std::string>& args)
+{
+    auto fullArgs = prepare(unit, args);
+    return hbcxx::system(unit.getExecutableFileName(), fullArgs);
+}
+
+int DefaultLauncher::replace(const CompilationUnit& unit,
+                             const std::list<std::string>& args)
+{
+    auto fullArgs = prepare(unit, args);
+
+    // the signals blocked whilst building would otherwise be inherited
+    hbcxx::unblock_signals();
+    hbcxx::exec(unit.getExecutableFileName(), fullArgs);
+
+    // unreachable; exec throws an exception if it cannot run the program
+    return 127;
+}
+
+/*!
+ * Generate the argument list (substituting the source file for arg0).
+ */
+std::list<std::string>
+DefaultLauncher::prepare(const CompilationUnit& unit,
+                         const std::list<std::string>& args)
 {
     auto verbose = Options::verbose();
 
@@ -41,6 +65,5 @@ int DefaultLauncher::launch(const CompilationUnit& unit,
     if (verbose)
         std::cerr << "hbcxx: running " << executable << " as: " << command
                   << std::endl;
-    return hbcxx::system(executable, fullArgs);
+    return fullArgs;
 }
-
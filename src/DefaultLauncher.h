@@ -22,6 +22,12 @@ public:
 
     virtual int launch(const CompilationUnit& unit,
                         const std::list<std::string>& args) override;
+    virtual int replace(const CompilationUnit& unit,
+                        const std::list<std::string>& args) override;
+
+private:
+    std::list<std::string> prepare(const CompilationUnit& unit,
+                                   const std::list<std::string>& args);
 };
 
 #endif // HBCXX_DEFAULT_LAUNCHER_H_
@@ -0,0 +1,187 @@
+/*
+ * DependencyDatabase.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "DependencyDatabase.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "Options.h"
+
+namespace file = boost::filesystem;
+
+static const char depsVersion[] = "hbcxx-deps-1";
+
+static std::string getRecordName(const std::string& objectFile)
+{
+    return objectFile + ".deps";
+}
+
+bool DependencyDatabase::isUpToDate(const std::string& objectFile)
+{
+    if (!Options::cache())
+	return false;
+
+    auto verbose = Options::verbose();
+    auto stale = [&](const std::string& reason) {
+	if (verbose)
+	    std::cerr << "hbcxx: object out of date: " << objectFile << ": "
+	              << reason << '\n';
+	return false;
+    };
+
+    auto st = hbcxx::FileStamp{};
+    if (!hbcxx::stamp(objectFile, st))
+	return stale("not built yet");
+
+    std::ifstream in{getRecordName(objectFile)};
+    auto line = std::string{};
+    if (!std::getline(in, line) || line != depsVersion)
+	return stale("no dependency record");
+
+    while (std::getline(in, line)) {
+	auto expected = hbcxx::FileStamp{};
+	auto fname = std::string{};
+	std::istringstream fields{line};
+	fields >> expected.dev >> expected.ino >> expected.size
+	       >> expected.mtime_ns;
+	fields.ignore(1);
+	std::getline(fields, fname);
+
+	auto actual = hbcxx::FileStamp{};
+	if (fields.fail() || !hbcxx::stamp(fname, actual) || actual != expected)
+	    return stale(fname + " has changed");
+    }
+
+    if (verbose)
+	std::cerr << "hbcxx: object up to date: " << objectFile << '\n';
+    hbcxx::markAccessed(objectFile);
+    hbcxx::markAccessed(getRecordName(objectFile));
+    return true;
+}
+
+void DependencyDatabase::record(const std::string& objectFile,
+                                const std::string& depFile,
+                                std::uint64_t startTime)
+{
+    auto dependencies = parseDepFile(depFile);
+    (void) std::remove(depFile.c_str());
+
+    // a header modified after the compiler started might not match what
+    // the compiler read, and one modified shortly before it started might
+    // have been modified again within the timestamp granularity. Either
+    // way we cannot trust its stamp.
+    auto tooNew = startTime - UINT64_C(2000000000);
+
+    std::ostringstream out;
+    out << depsVersion << '\n';
+
+    auto seen = std::set<std::string>{};
+    for (auto& dependency : dependencies) {
+	auto fname = file::absolute(dependency).string();
+	if (!seen.insert(fname).second)
+	    continue;
+
+	auto st = hbcxx::FileStamp{};
+	if (!hbcxx::stamp(fname, st) || st.mtime_ns > tooNew) {
+	    // without a record the object will simply be rebuilt next time
+	    (void) std::remove(getRecordName(objectFile).c_str());
+	    return;
+	}
+
+	out << st.dev << ' ' << st.ino << ' ' << st.size << ' '
+	    << st.mtime_ns << ' ' << fname << '\n';
+    }
+
+    (void) hbcxx::replaceFile(getRecordName(objectFile), out.str());
+}
+
+bool DependencyDatabase::getRecord(const std::string& objectFile,
+                                   std::string& dependencies)
+{
+    std::ifstream in{getRecordName(objectFile)};
+    auto line = std::string{};
+    if (!std::getline(in, line) || line != depsVersion)
+	return false;
+
+    dependencies.assign(std::istreambuf_iterator<char>{in},
+                        std::istreambuf_iterator<char>{});
+    return true;
+}
+
+/*!
+ * Extract the prerequisites from a make style dependency file.
+ *
+ * The compiler escapes spaces (and hashes) with a backslash and continues
+ * long rules with a trailing backslash.
+ */
+std::list<std::string> DependencyDatabase::parseDepFile(
+    const std::string& depFile)
+{
+    std::ifstream in{depFile};
+    auto rule = std::string{std::istreambuf_iterator<char>{in},
+                            std::istreambuf_iterator<char>{}};
+
+    auto dependencies = std::list<std::string>{};
+    auto token = std::string{};
+    auto inTarget = bool{true};
+    auto flush = [&]() {
+	if (!token.empty() && !inTarget)
+	    dependencies.push_back(token);
+	token.clear();
+    };
+
+    for (std::size_t i=0; i<rule.size(); i++) {
+	auto c = rule[i];
+	if (c == '\\' && i+1 < rule.size()) {
+	    auto next = rule[i+1];
+	    if (next == '\n') {
+		flush();
+		i++;
+		continue;
+	    }
+	    if (next == ' ' || next == '#' || next == '\\') {
+		token += next;
+		i++;
+		continue;
+	    }
+	}
+
+	if (c == '$' && i+1 < rule.size() && rule[i+1] == '$') {
+	    token += '$';
+	    i++;
+	} else if (c == ':' && inTarget &&
+	           (i+1 == rule.size() || rule[i+1] == ' ' ||
+	            rule[i+1] == '\n')) {
+	    token.clear();
+	    inTarget = false;
+	} else if (c == ' ' || c == '\t' || c == '\n') {
+	    flush();
+	    // -MP style phony rules (one per header) are ignored
+	    if (c == '\n' && !inTarget)
+		break;
+	} else {
+	    token += c;
+	}
+    }
+    flush();
+
+    return dependencies;
+}
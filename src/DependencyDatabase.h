@@ -0,0 +1,67 @@
+/*
+ * DependencyDatabase.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_DEPENDENCY_DATABASE_H_
+#define HBCXX_DEPENDENCY_DATABASE_H_
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+/*!
+ * Record of the header files used to build each object file.
+ *
+ * Object files are named after their compile command and source (see
+ * CompilationUnit::setObjectKey()) so an object file is up to date unless
+ * one of the headers it was built from has changed. The headers
+ * (including those in the system include directories) are gathered from
+ * the compiler's -MD output and stored, together with their stamps,
+ * alongside the object file (in foo-<key>.o.deps).
+ */
+class DependencyDatabase {
+public:
+    /*!
+     * Check whether an object file can be reused.
+     */
+    static bool isUpToDate(const std::string& objectFile);
+
+    /*!
+     * Record the dependencies of a newly published object file.
+     *
+     * Nothing is recorded (so the object will be rebuilt next time) if
+     * any dependency was modified after the compiler started, or too soon
+     * before it for the stamp to tell.
+     *
+     * \param depFile make style dependencies written by the compiler (the
+     *                file is removed once it has been read)
+     * \param startTime when the compiler was started (or any time before
+     *                  that), see hbcxx::currentTime()
+     */
+    static void record(const std::string& objectFile,
+                       const std::string& depFile, std::uint64_t startTime);
+
+    /*!
+     * Get the stamped dependencies recorded for an object file.
+     *
+     * \param dependencies receives one "dev ino size mtime fname" line for
+     *                     each dependency
+     * \returns false if the object file has no dependency record
+     */
+    static bool getRecord(const std::string& objectFile,
+                          std::string& dependencies);
+
+private:
+    static std::list<std::string> parseDepFile(const std::string& depFile);
+};
+
+#endif // HBCXX_DEPENDENCY_DATABASE_H_
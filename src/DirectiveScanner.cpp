@@ -0,0 +1,226 @@
+/*
+ * DirectiveScanner.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "DirectiveScanner.h"
+
+#include <algorithm>
+#include <cstring>
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline bool isIdentifier(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p != end && isBlank(*p))
+	++p;
+    return p;
+}
+
+/*!
+ * Find the next hash bang directive (double slash, hash, bang) at or
+ * after p.
+ */
+static const char* findHashBang(const char* p, const char* end)
+{
+    while (end - p >= 4) {
+	auto hash = static_cast<const char*>(std::memchr(p + 2, '#', end - p - 2));
+	if (nullptr == hash || end - hash < 2)
+	    return end;
+	if (hash[-2] == '/' && hash[-1] == '/' && hash[1] == '!')
+	    return hash - 2;
+	p = hash - 1;
+    }
+
+    return end;
+}
+
+const char* DirectiveScanner::matchInclude(const char* p, const char* end)
+{
+    static const char keyword[] = "include";
+    static const std::size_t keywordLen = sizeof(keyword) - 1;
+
+    p = skipBlanks(p, end);
+    if (p == end || *p != '#')
+	return nullptr;
+    p = skipBlanks(p + 1, end);
+    if (std::size_t(end - p) < keywordLen + 1 ||
+        0 != std::memcmp(p, keyword, keywordLen) ||
+        !isBlank(p[keywordLen]))
+	return nullptr;
+
+    return skipBlanks(p + keywordLen, end);
+}
+
+/*!
+ * Examine a line (which has already had any leading #! commented out).
+ *
+ * Each step mirrors one of the regular expressions that the pre-pre-processor
+ * once used. The regular expression is shown alongside each step; where a
+ * step differs from a naive reading of the expression this is because the
+ * expression is greedy (which is why the *last* directive is used for the
+ * lead in)
+ * or because regex_search() returns the *leftmost* match. The expressions
+ * are quoted to prevent them being mistaken for hash bang directives.
+ */
+static void scanLine(const char* begin, const char* end, ScannedLine& line)
+{
+    line.hasHashBang = false;
+    line.hashBangColumn = 0;
+    line.hashBangText = TextSpan{end, end};
+    line.hasFlags = false;
+    line.flags = TextSpan{end, end};
+    line.hasDirective = false;
+    line.directiveName = TextSpan{end, end};
+    line.directiveValue = TextSpan{end, end};
+    line.hasInterpreter = false;
+    line.include = ScannedLine::NoInclude;
+    line.includeFile = TextSpan{end, end};
+
+    // "^(.*)//#![ \t]*(.*)$"
+    // "//#![ \t]*(-.*)$"
+    // "//#![ \t]*([a-zA-Z_]*)[ \t]*:[ \t]*(.*)$"
+    // "//#![ \t]*/"
+    auto last = end;
+    for (auto p = findHashBang(begin, end); p != end;
+         p = findHashBang(p + 4, end)) {
+	last = p;
+	auto q = skipBlanks(p + 4, end);
+
+	if (!line.hasFlags && q != end && *q == '-') {
+	    line.hasFlags = true;
+	    line.flags = TextSpan{q, end};
+	}
+
+	if (!line.hasInterpreter && q != end && *q == '/')
+	    line.hasInterpreter = true;
+
+	if (!line.hasDirective) {
+	    auto r = q;
+	    while (r != end && isIdentifier(*r))
+		++r;
+	    auto s = skipBlanks(r, end);
+	    if (s != end && *s == ':') {
+		line.hasDirective = true;
+		line.directiveName = TextSpan{q, r};
+		line.directiveValue = TextSpan{skipBlanks(s + 1, end), end};
+	    }
+	}
+    }
+
+    if (last != end) {
+	// an odd number of double quotes prior to the directive means the
+	// directive appears within a string
+	auto quotes = std::count(begin, last, '"');
+	if (0 == (quotes & 1)) {
+	    line.hasHashBang = true;
+	    line.hashBangColumn = (last - begin) + 1;
+	    line.hashBangText = TextSpan{skipBlanks(last + 4, end), end};
+	}
+    }
+
+    // "^[ \t]*#[ \t]*include[ \t][ \t]*\"([^\"]*)\""
+    // "^[ \t]*#[ \t]*include[ \t][ \t]*<([^\"]*)>"
+    auto p = DirectiveScanner::matchInclude(begin, end);
+    if (nullptr != p && p != end) {
+	if (*p == '"') {
+	    auto close = static_cast<const char*>(
+	        std::memchr(p + 1, '"', end - p - 1));
+	    if (nullptr != close) {
+		line.include = ScannedLine::LocalInclude;
+		line.includeFile = TextSpan{p + 1, close};
+	    }
+	} else if (*p == '<') {
+	    auto quote = std::find(p + 1, end, '"');
+	    auto close = quote;
+	    while (close != p + 1 && close[-1] != '>')
+		--close;
+	    if (close != p + 1) {
+		line.include = ScannedLine::SystemInclude;
+		line.includeFile = TextSpan{p + 1, close - 1};
+	    }
+	}
+    }
+}
+
+DirectiveScanner::DirectiveScanner(const char* begin, const char* end)
+    : _begin{begin}
+    , _cursor{begin}
+    , _end{end}
+    , _lineno{1}
+    , _rewritten{}
+{
+}
+
+DirectiveScanner::~DirectiveScanner()
+{
+}
+
+bool DirectiveScanner::next(ScannedLine& line)
+{
+    if (_cursor == _end)
+	return false;
+
+    // lines without a '#' cannot contain anything of interest
+    auto hash = static_cast<const char*>(
+        std::memchr(_cursor, '#', _end - _cursor));
+    if (nullptr == hash) {
+	_cursor = _end;
+	return false;
+    }
+
+    // locate the start of the line containing the '#' and keep count of
+    // the lines we skipped over
+    auto lineBegin = hash;
+    while (lineBegin != _cursor && lineBegin[-1] != '\n')
+	--lineBegin;
+    _lineno += std::count(_cursor, lineBegin, '\n');
+
+    auto lineEnd = static_cast<const char*>(
+        std::memchr(hash, '\n', _end - hash));
+    if (nullptr == lineEnd)
+	lineEnd = _end;
+
+    line.number = _lineno;
+    line.original = TextSpan{lineBegin, lineEnd};
+
+    // "^([ \t]*)(#!)" -> "$1//$2"
+    auto p = skipBlanks(lineBegin, lineEnd);
+    if (lineEnd - p >= 2 && p[0] == '#' && p[1] == '!') {
+	line.rewriteOffset = p - lineBegin;
+
+	_rewritten.assign(lineBegin, p);
+	_rewritten += "//";
+	_rewritten.append(p, lineEnd);
+	scanLine(_rewritten.data(), _rewritten.data() + _rewritten.size(),
+	         line);
+    } else {
+	line.rewriteOffset = ScannedLine::npos;
+	scanLine(lineBegin, lineEnd, line);
+    }
+
+    // step over the newline (if there is one)
+    _cursor = lineEnd;
+    if (_cursor != _end) {
+	++_cursor;
+	++_lineno;
+    }
+
+    return true;
+}
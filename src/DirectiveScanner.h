@@ -0,0 +1,110 @@
+/*
+ * DirectiveScanner.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_DIRECTIVE_SCANNER_H_
+#define HBCXX_DIRECTIVE_SCANNER_H_
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * A run of characters within a line (or within the original buffer).
+ */
+struct TextSpan {
+    const char* begin;
+    const char* end;
+
+    std::size_t size() const { return end - begin; }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string(begin, end); }
+};
+
+/*!
+ * Everything the pre-pre-processor needs to know about a single line.
+ *
+ * Each field corresponds to one of the regular expressions that the
+ * pre-pre-processor historically applied to every line. With the exception
+ * of the original line and rewrite offset, all spans describe the line
+ * *after* any #! at the start of the line has been commented out.
+ */
+struct ScannedLine {
+    enum IncludeType { NoInclude, LocalInclude, SystemInclude };
+
+    std::size_t number;     //!< line number (counting from 1)
+    TextSpan original;      //!< the line as it appears in the buffer
+    std::size_t rewriteOffset; //!< where to insert "//" (or npos)
+
+    bool hasHashBang;       //!< found a directive outside of a string
+    std::size_t hashBangColumn; //!< column of the last directive
+    TextSpan hashBangText;  //!< everything after the last directive
+
+    bool hasFlags;          //!< found a raw flag directive
+    TextSpan flags;
+
+    bool hasDirective;      //!< found a "name: value" directive
+    TextSpan directiveName;
+    TextSpan directiveValue;
+
+    bool hasInterpreter;    //!< found an interpreter directive
+
+    IncludeType include;
+    TextSpan includeFile;
+
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+};
+
+/*!
+ * Single pass scanner for hash bang directives and #include directives.
+ *
+ * The scanner uses memchr() to skip quickly over lines that do not contain
+ * a '#' (which cannot contain anything of interest) and then parses the
+ * remaining lines by hand. Lines without a '#' are never reported.
+ *
+ * The scanner does not copy the buffer. Spans within a ScannedLine point
+ * either into the buffer or into storage owned by the scanner and remain
+ * valid until the next call to next().
+ */
+class DirectiveScanner {
+public:
+    DirectiveScanner(const char* begin, const char* end);
+    ~DirectiveScanner();
+
+    /*!
+     * Scan forward to the next line that contains a '#'.
+     *
+     * \returns false when the end of the buffer is reached
+     */
+    bool next(ScannedLine& line);
+
+    /*!
+     * Match "^[ \t]*#[ \t]*include[ \t]+" at the start of a line.
+     *
+     * This is the rule the scanner uses to recognise #include directives
+     * (so a directive without a blank after the keyword is not matched).
+     *
+     * \returns the character following the match or nullptr
+     */
+    static const char* matchInclude(const char* p, const char* end);
+
+private:
+    DirectiveScanner(const DirectiveScanner&);
+    DirectiveScanner& operator=(const DirectiveScanner&);
+
+    const char* _begin;
+    const char* _cursor;
+    const char* _end;
+    std::size_t _lineno;
+    std::string _rewritten;
+};
+
+#endif // HBCXX_DIRECTIVE_SCANNER_H_
@@ -0,0 +1,120 @@
+/*
+ * DirectoryCache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "DirectoryCache.h"
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+namespace file = boost::filesystem;
+
+namespace {
+
+struct Listing {
+    enum State {
+	Listed,   //!< entries are valid
+	Missing,  //!< the directory does not exist (so neither do its entries)
+	Unlisted  //!< the directory cannot be read (use ::stat() instead)
+    };
+
+    State state;
+
+    //! maps each name to whether it must be checked with ::stat() (because
+    //! it is a symbolic link or its type is unknown)
+    std::unordered_map<std::string, bool> entries;
+};
+
+} // anonymous namespace
+
+static std::unordered_map<std::string, Listing>& getListings()
+{
+    static std::unordered_map<std::string, Listing> listings;
+    return listings;
+}
+
+static std::size_t avoidedCalls = 0;
+
+static bool statExists(const std::string& fname)
+{
+    struct stat sb;
+    return 0 == ::stat(fname.c_str(), &sb);
+}
+
+static const Listing& getListing(const std::string& dir)
+{
+    auto& listings = getListings();
+    auto i = listings.find(dir);
+    if (i != listings.end())
+	return i->second;
+
+    auto listing = Listing{Listing::Listed,
+                           std::unordered_map<std::string, bool>{}};
+    auto dirp = ::opendir(dir.c_str());
+    if (nullptr == dirp) {
+	listing.state = (errno == ENOENT || errno == ENOTDIR)
+	                    ? Listing::Missing : Listing::Unlisted;
+    } else {
+	while (auto entry = ::readdir(dirp)) {
+	    auto type = entry->d_type;
+	    listing.entries.emplace(entry->d_name,
+	                            type == DT_LNK || type == DT_UNKNOWN);
+	}
+	::closedir(dirp);
+    }
+
+    return listings.emplace(dir, std::move(listing)).first->second;
+}
+
+bool DirectoryCache::exists(const std::string& fname)
+{
+    auto path = file::path{fname};
+    auto name = path.filename().string();
+    if (name.empty() || name == "." || name == ".." || name == "/")
+	return statExists(fname);
+
+    auto dir = path.parent_path().string();
+    if (dir.empty())
+	dir = ".";
+
+    auto& listing = getListing(dir);
+    if (listing.state == Listing::Unlisted)
+	return statExists(fname);
+
+    if (listing.state == Listing::Listed) {
+	auto i = listing.entries.find(name);
+	if (i != listing.entries.end() && i->second)
+	    return statExists(fname);
+
+	avoidedCalls++;
+	return i != listing.entries.end();
+    }
+
+    avoidedCalls++;
+    return false;
+}
+
+std::size_t DirectoryCache::getAvoidedCalls()
+{
+    return avoidedCalls;
+}
+
+std::size_t DirectoryCache::getListingCount()
+{
+    return getListings().size();
+}
@@ -0,0 +1,55 @@
+/*
+ * DirectoryCache.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_DIRECTORY_CACHE_H_
+#define HBCXX_DIRECTORY_CACHE_H_
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * Memoized directory listings.
+ *
+ * Each directory is read once (the first time a file within it is looked
+ * for) and all later existence checks within that directory are answered
+ * from the listing. This saves a great deal of time on network filesystems
+ * where every ::stat() is a round trip to the server.
+ *
+ * Listings are kept for the lifetime of the process and are never
+ * refreshed so the cache must only be used to look for files that hbcxx
+ * does not create itself. Reading a large directory costs far more than a
+ * single ::stat() so the cache is only worth using when several names are
+ * probed within the same directory.
+ */
+class DirectoryCache {
+public:
+    /*!
+     * Check whether a file (or directory) exists.
+     *
+     * Equivalent to boost::filesystem::exists() which means symbolic links
+     * are followed (and must still be checked with ::stat()).
+     */
+    static bool exists(const std::string& fname);
+
+    /*!
+     * Get the number of ::stat() calls that were answered from a listing.
+     */
+    static std::size_t getAvoidedCalls();
+
+    /*!
+     * Get the number of directories that have been read.
+     */
+    static std::size_t getListingCount();
+};
+
+#endif // HBCXX_DIRECTORY_CACHE_H_
@@ -0,0 +1,263 @@
+/*
+ * ExecutableCache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "ExecutableCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "hash.h"
+#include "system.h"
+#include "CompilationUnit.h"
+#include "DependencyDatabase.h"
+#include "Options.h"
+#include "Toolset.h"
+
+namespace file = boost::filesystem;
+
+ExecutableCache::ExecutableCache(const Toolset& toolset,
+                                 const std::list<CompilationUnit>& units)
+    : _directory{}
+    , _key{}
+    , _pending{}
+{
+    auto directory = getCacheDirectory();
+    if (directory.empty())
+	return;
+
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{"hbcxx-executable-cache-2"});
+    hash.update(toolset.getIdentity());
+    hash.update(std::string{Options::unity() ? "unity" : "separate"});
+
+    for (auto& flag : toolset.getFlags())
+	hash.update(flag);
+    hash.update(std::string{"--"});
+    for (auto& flag : toolset.getLateFlags())
+	hash.update(flag);
+
+    for (auto& unit : units) {
+	auto fname = unit.getInputFileName();
+
+	// the name is hashed as well as the contents because the name
+	// ends up in the executable (via __FILE__ and the #line markers)
+	hash.update(unit.getIsHeader() ? std::string{"header"}
+	                               : std::string{"source"});
+	hash.update(fname);
+	hash.update(file::absolute(fname).string());
+	for (auto& flag : unit.getPrivateFlags())
+	    hash.update(flag);
+
+	if (!hash.updateFromFile(fname)) {
+	    if (Options::verbose())
+		std::cerr << "hbcxx: cache disabled: cannot read " << fname
+		          << '\n';
+	    return;
+	}
+    }
+
+    _directory = directory;
+    _key = hash.hex();
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: cache key: " << _key << '\n';
+}
+
+ExecutableCache::ExecutableCache(const std::string& key)
+    : _directory{getCacheDirectory()}
+    , _key{}
+    , _pending{}
+{
+    if (!_directory.empty())
+	_key = key;
+}
+
+ExecutableCache::~ExecutableCache()
+{
+    // the link was interrupted before the executable could be published
+    if (!_pending.empty())
+	(void) std::remove(_pending.c_str());
+}
+
+bool ExecutableCache::isEnabled() const
+{
+    return !_key.empty();
+}
+
+const std::string& ExecutableCache::getKey() const
+{
+    return _key;
+}
+
+bool ExecutableCache::lookup(CompilationUnit& primary)
+{
+    if (!isEnabled())
+	return false;
+
+    auto verbose = Options::verbose();
+    auto exe = getExecutablePath();
+
+    std::ifstream in{getInfoPath()};
+    if (!in.is_open()) {
+	if (verbose)
+	    std::cerr << "hbcxx: cache miss: " << _key << '\n';
+	return false;
+    }
+
+    auto key = std::string{};
+    auto expected = hbcxx::FileStamp{};
+    in >> key >> expected.size >> expected.mtime_ns;
+
+    auto actual = hbcxx::FileStamp{};
+    if (in.fail() || key != _key) {
+	evict("bad info file");
+	return false;
+    }
+    if (!hbcxx::stamp(exe, actual)) {
+	evict("missing executable");
+	return false;
+    }
+    if (actual.size != expected.size || actual.mtime_ns != expected.mtime_ns) {
+	evict("executable has been modified");
+	return false;
+    }
+
+    // the key only covers the files the pre-pre-processor found; the
+    // headers the compiler found on the include path are checked here
+    auto line = std::string{};
+    std::getline(in, line); // discard the remainder of the mtime line
+    while (std::getline(in, line)) {
+	auto fname = std::string{};
+	std::istringstream fields{line};
+	fields >> expected.dev >> expected.ino >> expected.size
+	       >> expected.mtime_ns;
+	fields.ignore(1);
+	std::getline(fields, fname);
+
+	if (fields.fail() || !hbcxx::stamp(fname, actual) ||
+	    actual != expected) {
+	    evict(fname + " has changed");
+	    return false;
+	}
+    }
+
+    if (verbose)
+	std::cerr << "hbcxx: cache hit: " << exe << '\n';
+    hbcxx::markAccessed(exe);
+    hbcxx::markAccessed(getInfoPath());
+    primary.setExecutableFileName(exe);
+    return true;
+}
+
+void ExecutableCache::prepare(CompilationUnit& primary)
+{
+    if (!isEnabled())
+	return;
+
+    auto ec = boost::system::error_code{};
+    file::create_directories(_directory, ec);
+    if (ec)
+	return;
+
+    _pending = getExecutablePath() + hbcxx::unique();
+    primary.setExecutableFileName(_pending);
+}
+
+bool ExecutableCache::commit(CompilationUnit& primary,
+                             const std::list<std::string>& objectFiles)
+{
+    if (_pending.empty())
+	return false;
+
+    auto pending = std::move(_pending);
+    _pending.clear();
+
+    // every header used by the objects is recorded so that lookup() can
+    // tell when one has changed (objects without a record were built from
+    // headers too new to be trusted)
+    auto dependencies = std::string{};
+    auto seen = std::set<std::string>{};
+    for (auto& objectFile : objectFiles) {
+	auto record = std::string{};
+	if (!DependencyDatabase::getRecord(objectFile, record)) {
+	    if (Options::verbose())
+		std::cerr << "hbcxx: not cached: no dependency record for "
+		          << objectFile << '\n';
+	    return false;
+	}
+
+	std::istringstream lines{record};
+	for (auto line = std::string{}; std::getline(lines, line); )
+	    if (seen.insert(line).second)
+		dependencies += line + '\n';
+    }
+
+    // rename() preserves the inode so the stamp we take now remains valid
+    // once the executable has been published. If anything goes wrong we
+    // leave the executable where it is and the caller treats it as a
+    // temporary file.
+    auto st = hbcxx::FileStamp{};
+    auto exe = getExecutablePath();
+    if (!hbcxx::stamp(pending, st) ||
+        0 != std::rename(pending.c_str(), exe.c_str()))
+	return false;
+    primary.setExecutableFileName(exe);
+
+    std::ostringstream info;
+    info << _key << '\n' << st.size << '\n' << st.mtime_ns << '\n'
+         << dependencies;
+    if (!hbcxx::replaceFile(getInfoPath(), info.str()))
+	return false;
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: cached " << exe << '\n';
+    return true;
+}
+
+std::string ExecutableCache::getCacheDirectory()
+{
+    // an explicitly named executable must always be linked
+    if (!Options::cache() || !Options::executable().empty())
+	return std::string{};
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return std::string{};
+
+    return store + "/cache";
+}
+
+std::string ExecutableCache::getExecutablePath() const
+{
+    return _directory + '/' + _key + ".exe";
+}
+
+std::string ExecutableCache::getInfoPath() const
+{
+    return _directory + '/' + _key + ".info";
+}
+
+void ExecutableCache::evict(const std::string& reason)
+{
+    if (Options::verbose())
+	std::cerr << "hbcxx: cache miss: " << _key << ": " << reason << '\n';
+
+    (void) std::remove(getInfoPath().c_str());
+    (void) std::remove(getExecutablePath().c_str());
+}
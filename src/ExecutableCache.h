@@ -0,0 +1,93 @@
+/*
+ * ExecutableCache.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_EXECUTABLE_CACHE_H_
+#define HBCXX_EXECUTABLE_CACHE_H_
+
+#include <list>
+#include <string>
+
+class CompilationUnit;
+class Toolset;
+
+/*!
+ * Persistent, content addressed store of linked executables.
+ *
+ * Executables are kept in ~/.hbcxx/cache and are named after a hash of
+ * everything that went into building them: the contents of every source
+ * and header file the pre-pre-processor discovered, the final toolset flags
+ * and the identity of the compiler. If nothing has changed since the last
+ * run then the compile and link can be skipped entirely.
+ *
+ * Each executable is accompanied by an info file that records the key, the
+ * stamp of the executable and the stamp of every header the compiler
+ * reported using (see DependencyDatabase). An entry whose
+ * executable does not match its info file is treated as corrupt and one
+ * whose headers have changed is stale; both are discarded.
+ *
+ * Libraries named by -l flags are not recorded so an upgraded static
+ * library is not noticed until something else changes.
+ */
+class ExecutableCache {
+public:
+    ExecutableCache(const Toolset& toolset,
+                    const std::list<CompilationUnit>& units);
+
+    /*!
+     * Open the cache using a previously calculated key.
+     */
+    explicit ExecutableCache(const std::string& key);
+    ~ExecutableCache();
+
+    bool isEnabled() const;
+    const std::string& getKey() const;
+
+    /*!
+     * Look for a previously built executable.
+     *
+     * On a hit the executable file name of the primary unit is updated
+     * to point into the cache.
+     */
+    bool lookup(CompilationUnit& primary);
+
+    /*!
+     * Redirect the link output to a temporary file within the cache.
+     */
+    void prepare(CompilationUnit& primary);
+
+    /*!
+     * Atomically publish the executable produced after prepare().
+     *
+     * \param objectFiles the objects that were linked (the headers recorded
+     *                    for them by the DependencyDatabase are checked by
+     *                    later lookups)
+     * \returns true if the executable is now owned by the cache
+     */
+    bool commit(CompilationUnit& primary,
+                const std::list<std::string>& objectFiles);
+
+private:
+    ExecutableCache(const ExecutableCache&);
+    ExecutableCache& operator=(const ExecutableCache&);
+
+    static std::string getCacheDirectory();
+    std::string getExecutablePath() const;
+    std::string getInfoPath() const;
+    void evict(const std::string& reason);
+
+    std::string _directory;
+    std::string _key;
+    std::string _pending;
+};
+
+#endif // HBCXX_EXECUTABLE_CACHE_H_
@@ -0,0 +1,47 @@
+/*
+ * FlagSet.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "FlagSet.h"
+
+#include <utility>
+
+FlagSet::FlagSet()
+    : _flags{}
+    , _first{0}
+    , _index{}
+{
+}
+
+FlagSet::~FlagSet()
+{
+}
+
+bool FlagSet::contains(const std::string& flag) const
+{
+    return _index.find(flag) != _index.end();
+}
+
+void FlagSet::pushBack(std::string flag)
+{
+    auto position = _first + long(_flags.size());
+    _index[flag].push_back(position);
+    _flags.push_back(std::move(flag));
+}
+
+void FlagSet::pushFront(std::string flag)
+{
+    _first--;
+    auto& positions = _index[flag];
+    positions.insert(positions.begin(), _first);
+    _flags.push_front(std::move(flag));
+}
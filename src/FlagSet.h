@@ -0,0 +1,96 @@
+/*
+ * FlagSet.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_FLAG_SET_H_
+#define HBCXX_FLAG_SET_H_
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * An ordered sequence of compiler/linker flags.
+ *
+ * Flags are kept in the order they were pushed (which matters because we
+ * are running with a single pass linker) but each flag is also indexed by
+ * its position so checking whether a sequence of flags is already present
+ * does not require searching every flag.
+ */
+class FlagSet {
+public:
+    typedef std::deque<std::string>::const_iterator const_iterator;
+
+    FlagSet();
+    ~FlagSet();
+
+    const_iterator begin() const { return _flags.begin(); }
+    const_iterator end() const { return _flags.end(); }
+    std::size_t size() const { return _flags.size(); }
+    bool empty() const { return _flags.empty(); }
+
+    bool contains(const std::string& flag) const;
+
+    /*!
+     * Check whether the flags already appear, in order and without any
+     * other flags between them.
+     */
+    template <class Iterator>
+    bool contains(Iterator first, Iterator last) const;
+
+    template <class Container>
+    bool contains(const Container& flags) const
+    {
+        return contains(std::begin(flags), std::end(flags));
+    }
+
+    void pushBack(std::string flag);
+    void pushFront(std::string flag);
+
+private:
+    std::deque<std::string> _flags;
+
+    //! position of _flags.front() (pushFront() makes positions negative)
+    long _first;
+
+    //! positions at which each flag appears
+    std::unordered_map<std::string, std::vector<long>> _index;
+};
+
+template <class Iterator>
+bool FlagSet::contains(Iterator first, Iterator last) const
+{
+    if (first == last)
+	return true;
+
+    auto i = _index.find(*first);
+    if (i == _index.end())
+	return false;
+
+    for (auto position : i->second) {
+	auto p = _flags.begin() + (position - _first);
+	auto q = first;
+	while (q != last && p != _flags.end() && *p == *q) {
+	    ++p;
+	    ++q;
+	}
+	if (q == last)
+	    return true;
+    }
+
+    return false;
+}
+
+#endif // HBCXX_FLAG_SET_H_
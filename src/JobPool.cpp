@@ -0,0 +1,594 @@
+/*
+ * JobPool.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "JobPool.h"
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "string.h"
+#include "system.h"
+#include "Options.h"
+
+//! marks the epoll events of the pipes that feed input to our jobs
+static const std::uint64_t feedTag = std::uint64_t{1} << 32;
+
+/*!
+ * Create an empty file to capture the diagnostics of a speculative job.
+ */
+static std::string makeLogFile()
+{
+    auto tmpdir = std::getenv("TMPDIR");
+    auto name = std::string{tmpdir ? tmpdir : "/tmp"} + "/hbcxx-XXXXXX";
+
+    auto buf = std::vector<char>(name.begin(), name.end());
+    buf.push_back('\0');
+    auto fd = mkstemp(buf.data());
+    if (-1 == fd)
+	return std::string{};
+
+    (void) close(fd);
+    return std::string{buf.data()};
+}
+
+/*!
+ * Get a file descriptor that becomes readable when the child terminates.
+ *
+ * \returns the descriptor or -1 if pidfds are not supported
+ */
+static int openPidfd(pid_t pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void) pid;
+    return -1;
+#endif
+}
+
+JobPool::JobPool(unsigned maxJobs)
+    : _maxJobs{maxJobs ? maxJobs : 1}
+    , _epoll{-1}
+    , _signals{-1}
+    , _running{}
+    , _feeds{}
+    , _speculated{}
+    , _queued{}
+    , _prerequisites{}
+    , _failed{false}
+    , _oldSigpipe{SIG_DFL}
+{
+    // if a compiler exits without reading all its input we must get EPIPE
+    // rather than being killed by SIGPIPE
+    _oldSigpipe = signal(SIGPIPE, SIG_IGN);
+
+#ifdef __linux__
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    // wake up if the user interrupts us (see hbcxx::block_signals()); the
+    // signals are left pending for hbcxx::poll_signals() to report
+    sigset_t set;
+    (void) sigemptyset(&set);
+    (void) sigaddset(&set, SIGINT);
+    (void) sigaddset(&set, SIGQUIT);
+    if (-1 != _epoll)
+	_signals = signalfd(-1, &set, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (-1 != _signals) {
+	auto event = epoll_event{};
+	event.events = EPOLLIN;
+	event.data.u64 = 0;
+	if (0 != epoll_ctl(_epoll, EPOLL_CTL_ADD, _signals, &event)) {
+	    (void) close(_signals);
+	    _signals = -1;
+	}
+    }
+#endif
+}
+
+JobPool::~JobPool()
+{
+    cancel();
+
+    if (-1 != _signals)
+	(void) close(_signals);
+    if (-1 != _epoll)
+	(void) close(_epoll);
+    (void) signal(SIGPIPE, _oldSigpipe);
+}
+
+bool JobPool::submit(const std::list<std::string>& command,
+                     const ProcessedSource& input, const std::string& after)
+{
+    while (!_failed && !hasFreeSlot())
+	reap(true);
+
+    if (_failed)
+	return false;
+
+    auto job = Job{command, {}, std::string{}, std::string{}, nullptr, false,
+                   false, 0, -1};
+    _queued.push_back(QueuedJob{std::move(job), input, after});
+    startQueued();
+    return !_failed;
+}
+
+void JobPool::prepare(const std::string& name,
+                      const std::list<std::string>& command,
+                      const std::list<std::string>& outputs,
+                      std::function<void(bool)> finished)
+{
+    if (_failed || _prerequisites.count(name))
+	return;
+    _prerequisites[name] = false;
+
+    // the diagnostics are captured (and the job grouped) just as for a
+    // speculative job
+    auto job = Job{command, outputs, makeLogFile(), name, std::move(finished),
+                   false, true, 0, -1};
+    _queued.push_back(QueuedJob{std::move(job), ProcessedSource{},
+                                std::string{}});
+    startQueued();
+}
+
+bool JobPool::speculate(const std::list<std::string>& command,
+                        const std::list<std::string>& outputs,
+                        const ProcessedSource& input)
+{
+    // collect anything that has already finished without blocking
+    reap(false);
+
+    if (_failed || !hasFreeSlot())
+	return false;
+
+    auto log = makeLogFile();
+    if (log.empty())
+	return false;
+
+    auto job = Job{command, outputs, log, std::string{}, nullptr, true, true,
+                   0, -1};
+    if (-1 == start(std::move(job), input)) {
+	(void) std::remove(log.c_str());
+	return false;
+    }
+
+    return true;
+}
+
+bool JobPool::adopt(const std::list<std::string>& command)
+{
+    for (auto& running : _running) {
+	auto& job = running.second;
+	if (job.speculative && job.command == command) {
+	    if (Options::verbose())
+		std::cerr << "hbcxx: adopted: " << hbcxx::shjoin(command)
+		          << std::endl;
+	    job.speculative = false;
+	    return true;
+	}
+    }
+
+    for (auto i = _speculated.begin(); i != _speculated.end(); ++i) {
+	if (i->command == command) {
+	    if (Options::verbose())
+		std::cerr << "hbcxx: adopted: " << hbcxx::shjoin(command)
+		          << std::endl;
+	    auto job = std::move(*i);
+	    _speculated.erase(i);
+	    finish(job);
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+void JobPool::discardSpeculative()
+{
+    for (auto& running : _running)
+	if (running.second.speculative)
+	    kill(running.first, running.second);
+
+    for (auto i = _running.begin(); i != _running.end(); ) {
+	auto& job = i->second;
+	if (!job.speculative) {
+	    ++i;
+	    continue;
+	}
+
+	auto res = int{};
+	(void) hbcxx::reap(i->first, res);
+	dropFeed(i->first);
+	forget(job);
+	i = _running.erase(i);
+    }
+
+    for (auto& job : _speculated)
+	forget(job);
+    _speculated.clear();
+}
+
+bool JobPool::wait()
+{
+    for (;;) {
+	startQueued();
+
+	auto outstanding = !_queued.empty();
+	for (auto& running : _running)
+	    if (!running.second.speculative)
+		outstanding = true;
+	if (!outstanding)
+	    break;
+
+	reap(true);
+    }
+
+    return !_failed;
+}
+
+/*!
+ * Start as many queued jobs as there are free slots (skipping any that
+ * are waiting for a prerequisite that has not finished).
+ */
+void JobPool::startQueued()
+{
+    for (auto i = _queued.begin(); i != _queued.end() && hasFreeSlot(); ) {
+	if (_failed)
+	    return;
+
+	auto prerequisite = _prerequisites.find(i->after);
+	if (prerequisite != _prerequisites.end() && !prerequisite->second) {
+	    ++i;
+	    continue;
+	}
+
+	auto queued = std::move(*i);
+	i = _queued.erase(i);
+	if (-1 != start(queued.job, queued.input))
+	    continue;
+
+	if (!queued.job.name.empty()) {
+	    finishPrerequisite(queued.job, false);
+	    continue;
+	}
+
+	std::cerr << "hbcxx: error: cannot run: "
+	          << hbcxx::shjoin(queued.job.command) << '\n';
+	_failed = true;
+	cancel();
+	return;
+    }
+}
+
+pid_t JobPool::start(Job job, const ProcessedSource& input)
+{
+    if (Options::verbose())
+	std::cerr << (job.speculative ? "hbcxx: speculating: "
+	                              : "hbcxx: running: ")
+	          << hbcxx::shjoin(job.command) << std::endl;
+
+    int fds[2] = { -1, -1 };
+    if (!input.empty() && 0 != pipe2(fds, O_CLOEXEC))
+	return -1;
+
+    auto pid = hbcxx::spawn(job.command.front(), job.command, fds[0],
+                            job.log, job.grouped);
+    if (-1 != fds[0])
+	(void) close(fds[0]);
+    if (-1 == pid) {
+	if (-1 != fds[1])
+	    (void) close(fds[1]);
+	return pid;
+    }
+
+#ifdef __linux__
+    if (-1 != _epoll)
+	job.pidfd = openPidfd(pid);
+    if (-1 != job.pidfd) {
+	auto event = epoll_event{};
+	event.events = EPOLLIN;
+	event.data.u64 = static_cast<std::uint64_t>(pid);
+	if (0 != epoll_ctl(_epoll, EPOLL_CTL_ADD, job.pidfd, &event)) {
+	    (void) close(job.pidfd);
+	    job.pidfd = -1;
+	}
+    }
+#endif
+
+    auto pidfd = job.pidfd;
+    _running.emplace(pid, std::move(job));
+
+    // the input is written whilst we wait for the jobs (rather than
+    // blocking until the compiler has read all of it)
+    if (-1 != fds[1]) {
+	(void) fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	_feeds.emplace(pid, Feed{input, 0, fds[1]});
+	feed(pid);
+#ifdef __linux__
+	if (_feeds.count(pid) && -1 != pidfd) {
+	    auto event = epoll_event{};
+	    event.events = EPOLLOUT;
+	    event.data.u64 = feedTag | static_cast<std::uint64_t>(pid);
+	    if (0 != epoll_ctl(_epoll, EPOLL_CTL_ADD, fds[1], &event))
+		pidfd = -1;
+	}
+#endif
+	if (_feeds.count(pid) && -1 == pidfd)
+	    flushFeeds();
+    }
+
+    return pid;
+}
+
+/*!
+ * Write as much of a job's input as its pipe will accept.
+ *
+ * The pipe is closed once all of the input has been written (or the job
+ * has stopped reading it).
+ */
+void JobPool::feed(pid_t pid)
+{
+    auto i = _feeds.find(pid);
+    if (i == _feeds.end())
+	return;
+
+    auto& feed = i->second;
+    if (feed.source.write(feed.fd, feed.offset) &&
+        feed.offset < feed.source.size())
+	return;
+
+    // a short write is reported by the compiler rather than by us
+    dropFeed(pid);
+}
+
+/*!
+ * Write all outstanding input, blocking if necessary.
+ *
+ * This is needed before we wait for a child without epoll (since nothing
+ * would top up the pipes whilst we wait).
+ */
+void JobPool::flushFeeds()
+{
+    for (auto& i : _feeds) {
+	auto& feed = i.second;
+	(void) fcntl(feed.fd, F_SETFL, 0);
+	(void) feed.source.write(feed.fd, feed.offset);
+    }
+
+    while (!_feeds.empty())
+	dropFeed(_feeds.begin()->first);
+}
+
+void JobPool::dropFeed(pid_t pid)
+{
+    auto i = _feeds.find(pid);
+    if (i == _feeds.end())
+	return;
+
+    // closing the descriptor also removes it from the epoll set
+    (void) close(i->second.fd);
+    _feeds.erase(i);
+}
+
+void JobPool::reap(bool block)
+{
+    if (_running.empty())
+	return;
+
+    auto res = int{};
+    auto pid = waitForAnyJob(res, block);
+    if (0 == pid)
+	return;
+    if (-1 == pid) {
+	// we have lost track of our children (which should be impossible)
+	// so, since they cannot be reaped, all we can do is release what
+	// they were holding
+	auto err = errno;
+	std::cerr << "hbcxx: error: lost track of jobs: " << std::strerror(err)
+	          << '\n';
+	for (auto& running : _running) {
+	    std::cerr << "hbcxx: abandoned: "
+	              << hbcxx::shjoin(running.second.command) << '\n';
+	    dropFeed(running.first);
+	    forget(running.second);
+	}
+	_running.clear();
+	_failed = true;
+	cancel();
+	return;
+    }
+
+    auto i = _running.find(pid);
+    if (i == _running.end())
+	return; // not one of ours
+
+    auto job = std::move(i->second);
+    _running.erase(i);
+    dropFeed(pid);
+    job.status = res;
+    if (-1 != job.pidfd)
+	(void) close(job.pidfd);
+    job.pidfd = -1;
+
+    // if the user interrupted the build then the job probably failed
+    // because it was signalled; make sure we report the signal rather
+    // than the failure
+    hbcxx::poll_signals();
+
+    if (!job.name.empty())
+	finishPrerequisite(job, WIFEXITED(res) && 0 == WEXITSTATUS(res));
+    else if (job.speculative)
+	_speculated.push_back(std::move(job));
+    else
+	finish(job);
+
+    startQueued();
+}
+
+/*!
+ * Wait for one of our jobs to terminate.
+ *
+ * If every running job has a pidfd then we wait only for our own
+ * children using epoll. Otherwise we must wait for any child at all.
+ */
+pid_t JobPool::waitForAnyJob(int& res, bool block)
+{
+#ifdef __linux__
+    auto tracked = -1 != _epoll;
+    for (auto& running : _running)
+	if (-1 == running.second.pidfd)
+	    tracked = false;
+
+    while (tracked) {
+	epoll_event events[16];
+	auto n = epoll_wait(_epoll, events, 16, block ? -1 : 0);
+	if (n < 0) {
+	    if (EINTR == errno)
+		continue;
+	    break;
+	}
+
+	for (auto i=0; i<n; i++) {
+	    if (events[i].data.u64 & feedTag) {
+		feed(static_cast<pid_t>(events[i].data.u64 & ~feedTag));
+		continue;
+	    }
+
+	    auto pid = static_cast<pid_t>(events[i].data.u64);
+	    if (0 == pid) {
+		hbcxx::poll_signals();
+		continue;
+	    }
+	    auto reaped = hbcxx::reap(pid, res, true);
+	    if (pid == reaped || -1 == reaped)
+		return reaped; // a job has exited but may not be reapable
+	}
+
+	if (!block)
+	    return 0;
+    }
+#endif
+
+    flushFeeds();
+    return hbcxx::wait(res, !block);
+}
+
+void JobPool::finish(Job& job)
+{
+    // replay any diagnostics we captured whilst the job was speculative
+    if (!job.log.empty()) {
+	std::ifstream log{job.log};
+	if (log.peek() != std::ifstream::traits_type::eof())
+	    std::cerr << log.rdbuf();
+	(void) std::remove(job.log.c_str());
+    }
+
+    if (!WIFEXITED(job.status) || 0 != WEXITSTATUS(job.status)) {
+	_failed = true;
+	cancel();
+    }
+}
+
+void JobPool::finishPrerequisite(Job& job, bool ok)
+{
+    // the diagnostics of a failed prerequisite are only of interest if
+    // nothing else is going to report the problem
+    if (!ok && Options::verbose())
+	std::cerr << "hbcxx: failed: " << hbcxx::shjoin(job.command) << '\n';
+    if ((ok || Options::verbose()) && !job.log.empty()) {
+	std::ifstream log{job.log};
+	if (log.peek() != std::ifstream::traits_type::eof())
+	    std::cerr << log.rdbuf();
+    }
+
+    if (!job.log.empty())
+	(void) std::remove(job.log.c_str());
+    job.log.clear();
+    if (!ok)
+	forget(job);
+
+    _prerequisites[job.name] = true;
+    if (job.finished)
+	job.finished(ok);
+}
+
+void JobPool::cancel()
+{
+    for (auto& running : _running)
+	kill(running.first, running.second);
+
+    for (auto& running : _running) {
+	auto res = int{};
+	(void) hbcxx::reap(running.first, res);
+	dropFeed(running.first);
+	forget(running.second);
+    }
+    _running.clear();
+
+    for (auto& job : _speculated)
+	forget(job);
+    _speculated.clear();
+
+    for (auto& queued : _queued)
+	forget(queued.job);
+    _queued.clear();
+}
+
+/*!
+ * Ask a job (and, if it has its own process group, all of its children)
+ * to terminate.
+ */
+void JobPool::kill(pid_t pid, const Job& job)
+{
+    (void) ::kill(job.grouped ? -pid : pid, SIGTERM);
+}
+
+/*!
+ * Release everything belonging to a job that has been (or is about to be)
+ * reaped without being finished, including any files it was writing.
+ */
+void JobPool::forget(Job& job)
+{
+    if (-1 != job.pidfd)
+	(void) close(job.pidfd);
+    job.pidfd = -1;
+
+    if (!job.log.empty())
+	(void) std::remove(job.log.c_str());
+
+    for (auto& output : job.outputs)
+	if (0 == std::remove(output.c_str()) && Options::verbose())
+	    std::cerr << "hbcxx: removed " << output << '\n';
+}
+
+bool JobPool::hasFreeSlot() const
+{
+    return _running.size() < _maxJobs;
+}
@@ -0,0 +1,180 @@
+/*
+ * JobPool.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_JOB_POOL_H_
+#define HBCXX_JOB_POOL_H_
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+
+#include "ProcessedSource.h"
+
+/*!
+ * Run commands concurrently with a bounded number of jobs.
+ *
+ * Commands are argument vectors (including argv[0]) and are run directly
+ * rather than via the shell. On Linux each job is tracked with a pidfd so
+ * that the pool waits only for its own children; elsewhere it falls back
+ * to waiting for any child.
+ *
+ * The first job to fail causes every other outstanding job to be killed
+ * and prevents any further jobs from being started. Jobs are also killed
+ * if the pool is destroyed before they complete (which happens if an
+ * exception, such as hbcxx::signal_exception, unwinds past the pool).
+ * Thus once the pool is gone no child can still be writing to the files
+ * that hbcxx is about to remove.
+ *
+ * Speculative jobs can be started before it is certain that their command
+ * is correct. Their diagnostics are captured and they are not allowed to
+ * fail the pool until they are adopted by a matching call to adopt(). Any
+ * that are not adopted must be thrown away using discardSpeculative()
+ * before their replacements are submitted. Discarding a speculative job
+ * (or cancelling it) also removes the files it was writing. Speculative jobs
+ * run in their own process group so that nothing the command started can
+ * still be writing those files once they are removed. They do not receive
+ * the SIGINT from the terminal so the pool watches for it instead.
+ *
+ * A prerequisite is a job that other jobs can wait for (see prepare()).
+ * Prerequisites are allowed to fail; the jobs waiting for them are started
+ * regardless.
+ */
+class JobPool {
+public:
+    explicit JobPool(unsigned maxJobs);
+    ~JobPool();
+
+    /*!
+     * Start a command as soon as a job slot becomes free.
+     *
+     * If input is not empty it is fed to the command's standard input
+     * (through a pipe that the pool keeps topped up whilst it waits for
+     * its jobs). If after names a prerequisite then the command is not started until the
+     * prerequisite has finished.
+     *
+     * \returns false if an earlier job failed (in which case the command
+     *          is not run)
+     */
+    bool submit(const std::list<std::string>& command,
+                const ProcessedSource& input = ProcessedSource{},
+                const std::string& after = std::string{});
+
+    /*!
+     * Start a prerequisite as soon as a job slot becomes free.
+     *
+     * Nothing is done if a prerequisite with the same name has already
+     * been prepared. The diagnostics of a failed prerequisite are only
+     * shown in verbose mode and the files it was writing (outputs) are
+     * removed. finished is called with the result as soon as the
+     * prerequisite completes (and before anything waiting for it starts).
+     */
+    void prepare(const std::string& name,
+                 const std::list<std::string>& command,
+                 const std::list<std::string>& outputs,
+                 std::function<void(bool)> finished);
+
+    /*!
+     * Start a speculative command if a job slot is free right now.
+     *
+     * outputs lists the files written by the command; they are removed if
+     * the job is discarded (or cancelled) rather than adopted.
+     *
+     * \returns false if the command was not started
+     */
+    bool speculate(const std::list<std::string>& command,
+                   const std::list<std::string>& outputs,
+                   const ProcessedSource& input = ProcessedSource{});
+
+    /*!
+     * Take ownership of a speculative job with exactly this command.
+     *
+     * Once adopted the job behaves as though it had been submitted; its
+     * diagnostics are shown and it is able to fail the pool.
+     *
+     * \returns false if no speculative job has this command
+     */
+    bool adopt(const std::list<std::string>& command);
+
+    /*!
+     * Kill and forget all speculative jobs that were not adopted.
+     */
+    void discardSpeculative();
+
+    /*!
+     * Wait for every outstanding (non-speculative) job, including the
+     * prerequisites and the jobs waiting for them, to complete.
+     *
+     * \returns false if any job failed
+     */
+    bool wait();
+
+private:
+    struct Job {
+	std::list<std::string> command;
+	std::list<std::string> outputs;
+	std::string log;
+	std::string name; // prerequisites only
+	std::function<void(bool)> finished;
+	bool speculative;
+	bool grouped;
+	int status;
+	int pidfd;
+    };
+
+    struct QueuedJob {
+	Job job;
+	ProcessedSource input;
+	std::string after;
+    };
+
+    //! input that is still being written to a job's standard input
+    struct Feed {
+	ProcessedSource source;
+	std::size_t offset;
+	int fd;
+    };
+
+    JobPool(const JobPool&);
+    JobPool& operator=(const JobPool&);
+
+    pid_t start(Job job, const ProcessedSource& input);
+    void reap(bool block);
+    pid_t waitForAnyJob(int& res, bool block);
+    void feed(pid_t pid);
+    void flushFeeds();
+    void dropFeed(pid_t pid);
+    void startQueued();
+    void finish(Job& job);
+    void finishPrerequisite(Job& job, bool ok);
+    void forget(Job& job);
+    void kill(pid_t pid, const Job& job);
+    void cancel();
+    bool hasFreeSlot() const;
+
+    unsigned _maxJobs;
+    int _epoll;
+    int _signals;
+    std::map<pid_t, Job> _running;
+    std::map<pid_t, Feed> _feeds;
+    std::list<Job> _speculated;
+    std::list<QueuedJob> _queued;
+    std::map<std::string, bool> _prerequisites; // name -> has finished
+    bool _failed;
+    void (*_oldSigpipe)(int);
+};
+
+#endif // HBCXX_JOB_POOL_H_
@@ -17,6 +17,7 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include "BenchLauncher.h"
 #include "DefaultLauncher.h"
 #include "GdbLauncher.h"
 #include "Options.h"
@@ -27,6 +28,10 @@ std::unique_ptr<Launcher> makeLauncher()
 {
     auto debugger = Options::debugger();
 
+    if (Options::bench())
+	return std::unique_ptr<Launcher>{
+	    new BenchLauncher{Options::bench(), Options::benchWarmup()}};
+
     if (debugger.empty())
 	return std::unique_ptr<Launcher>{new DefaultLauncher{}};
 
@@ -26,6 +26,22 @@ public:
 
     virtual int launch(const CompilationUnit& unit,
                         const std::list<std::string>& args) = 0;
+
+    /*!
+     * Launch the executable in place of the current process.
+     *
+     * This is only suitable when nothing needs to be cleaned up once the
+     * executable has terminated. Launchers that must supervise the
+     * executable fall back to launch().
+     *
+     * \returns the status from launch() (does not return if the process
+     *          is replaced)
+     */
+    virtual int replace(const CompilationUnit& unit,
+                        const std::list<std::string>& args)
+    {
+	return launch(unit, args);
+    }
 };
 
 std::unique_ptr<Launcher> makeLauncher();
@@ -0,0 +1,168 @@
+/*
+ * Manifest.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "Manifest.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "hash.h"
+#include "Options.h"
+
+namespace file = boost::filesystem;
+
+static const char manifestVersion[] = "hbcxx-manifest-1";
+
+Manifest::Manifest(const std::string& primaryFile,
+                   const std::list<std::string>& flags)
+    : _fileName{}
+{
+    // the manifest is only useful if it can lead us to a cached executable
+    if (!Options::cache() || !Options::executable().empty())
+	return;
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return;
+
+    // everything (other than file contents) that can influence the build
+    // must be part of the key
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{manifestVersion});
+    hash.update(primaryFile);
+    hash.update(file::absolute(primaryFile).string());
+    for (auto& flag : flags)
+	hash.update(flag);
+    hash.update(std::string{"--"});
+    hash.update(Options::cxx());
+    hash.update(Options::debugger());
+    hash.update(Options::optimization());
+    hash.update(std::string{Options::unity() ? "unity" : "separate"});
+    for (auto var : { "CXX", "PATH", "PKG_CONFIG_PATH", "PKG_CONFIG_LIBDIR" }) {
+	auto value = std::getenv(var);
+	hash.update(std::string{value ? "=" : "!"} + (value ? value : ""));
+    }
+
+    _fileName = store + "/manifest/" + hash.hex();
+}
+
+Manifest::~Manifest()
+{
+}
+
+bool Manifest::isEnabled() const
+{
+    return !_fileName.empty();
+}
+
+std::string Manifest::getLockFileName() const
+{
+    if (!isEnabled())
+	return std::string{};
+    return _fileName + ".lock";
+}
+
+std::string Manifest::check() const
+{
+    if (!isEnabled())
+	return std::string{};
+
+    auto verbose = Options::verbose();
+
+    std::ifstream in{_fileName};
+    auto version = std::string{};
+    auto key = std::string{};
+    in >> version >> key;
+    if (in.fail() || version != manifestVersion) {
+	if (verbose)
+	    std::cerr << "hbcxx: manifest miss: " << _fileName << '\n';
+	return std::string{};
+    }
+
+    auto line = std::string{};
+    std::getline(in, line); // discard the remainder of the first line
+    while (std::getline(in, line)) {
+	std::istringstream ss{line};
+	auto expected = hbcxx::FileStamp{};
+	auto present = bool{line[0] != '-'};
+	if (present)
+	    ss >> expected.dev >> expected.ino >> expected.size
+	       >> expected.mtime_ns;
+	else
+	    ss.ignore(1);
+	ss.ignore(1);
+
+	auto fname = std::string{};
+	std::getline(ss, fname);
+
+	auto actual = hbcxx::FileStamp{};
+	auto exists = hbcxx::stamp(fname, actual);
+	if (exists != present || (present && actual != expected)) {
+	    if (verbose)
+		std::cerr << "hbcxx: manifest stale: " << fname
+		          << (present ? " has changed\n" : " has appeared\n");
+	    return std::string{};
+	}
+    }
+
+    if (verbose)
+	std::cerr << "hbcxx: manifest hit: " << _fileName << '\n';
+    hbcxx::markAccessed(_fileName);
+    return key;
+}
+
+void Manifest::update(const std::string& cacheKey,
+                      const std::list<hbcxx::StampedFile>& dependencies) const
+{
+    if (!isEnabled())
+	return;
+
+    auto ec = boost::system::error_code{};
+    file::create_directories(file::path{_fileName}.parent_path(), ec);
+    if (ec)
+	return;
+
+    std::ostringstream out;
+    out << manifestVersion << ' ' << cacheKey << '\n';
+
+    // the stamps were taken before the files were read so a file that was
+    // modified during the build will not match next time
+    auto seen = std::set<std::string>{};
+    for (auto& dependency : dependencies) {
+	auto fname = file::absolute(dependency.fname).string();
+	if (!seen.insert(fname).second)
+	    continue;
+
+	if (dependency.isRecent) {
+	    if (Options::verbose())
+		std::cerr << "hbcxx: manifest not written: " << fname
+		          << " was modified too recently\n";
+	    return;
+	}
+
+	auto& st = dependency.st;
+	if (dependency.exists)
+	    out << st.dev << ' ' << st.ino << ' ' << st.size << ' '
+	        << st.mtime_ns << ' ' << fname << '\n';
+	else
+	    out << "- " << fname << '\n';
+    }
+
+    (void) hbcxx::replaceFile(_fileName, out.str());
+}
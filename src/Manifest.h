@@ -0,0 +1,73 @@
+/*
+ * Manifest.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_MANIFEST_H_
+#define HBCXX_MANIFEST_H_
+
+#include <list>
+#include <string>
+
+#include "filesystem.h"
+
+/*!
+ * Record of the files that went into building a program.
+ *
+ * Each program has a manifest, stored in ~/.hbcxx/manifest, that lists
+ * the stamp (device, inode, size and modification time) of every file that
+ * was examined whilst building it together with the key of the resulting
+ * entry in the ExecutableCache. If none of the stamps have changed then
+ * the program can be launched from the cache without pre-pre-processing,
+ * hashing or toolset detection.
+ *
+ * Files that were probed for but did not exist are also recorded; if
+ * they appear later then the manifest no longer matches.
+ */
+class Manifest {
+public:
+    Manifest(const std::string& primaryFile,
+             const std::list<std::string>& flags);
+    ~Manifest();
+
+    bool isEnabled() const;
+
+    /*!
+     * Get the name of the file used to serialize builds of this program.
+     *
+     * \returns the file name (or an empty string if the manifest is
+     *          disabled)
+     */
+    std::string getLockFileName() const;
+
+    /*!
+     * Compare the manifest against the filesystem.
+     *
+     * \returns the executable cache key if nothing has changed, otherwise
+     *          an empty string
+     */
+    std::string check() const;
+
+    /*!
+     * Replace the manifest.
+     *
+     * \param dependencies the files used by the build, stamped before they
+     *                     were read (the manifest is not written if any of
+     *                     these stamps cannot be trusted)
+     */
+    void update(const std::string& cacheKey,
+                const std::list<hbcxx::StampedFile>& dependencies) const;
+
+private:
+    std::string _fileName;
+};
+
+#endif // HBCXX_MANIFEST_H_
@@ -13,6 +13,12 @@
 
 #include "Options.h"
 
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -25,19 +31,110 @@ using boost::trim_left;
 static struct {
     bool verbose;
     bool saveTemps;
+    bool noCache;
+    bool cacheGc;
+    bool unity;
+    bool time;
+    bool rusage;
     std::string commandName;
     std::string cxx;
     std::string debugger;
     std::string executable;
     std::string optimization;
-} optionStore = { false, false };bool Options::verbose() { return optionStore.verbose; }
+    std::string trace;
+    std::string rusageFile;
+    std::string benchInput;
+    unsigned jobs;
+    std::uint64_t cacheSize;
+    unsigned cacheAge;
+    unsigned bench;
+    unsigned benchWarmup;
+    unsigned benchCpu; // CPU number plus one (zero if not pinned)
+} optionStore = { false, false };
+
+static bool parsingOptionsFile = false;
+
+/*!
+ * Reject an hbcxx option whose value makes no sense.
+ *
+ * Options on the command line are fatal (passing them on to the compiler or
+ * the program would only hide the mistake) but a bad option in the options
+ * file is reported by parseOptionsFile() and ignored.
+ */
+static bool badValue(const std::string& arg)
+{
+    if (parsingOptionsFile)
+	return false;
+
+    std::cerr << PACKAGE_NAME << ": invalid option value: " << arg << '\n';
+    std::exit(125);
+}
+
+/*!
+ * Parse the decimal value of an option.
+ *
+ * \returns false unless the whole value is a number between min and max
+ */
+static bool parseNumber(const char* value, unsigned long min,
+                        unsigned long max, unsigned long& result)
+{
+    // strtoul() would skip blanks and quietly negate a leading minus sign
+    if (!std::isdigit(static_cast<unsigned char>(*value)))
+	return false;
+
+    auto end = static_cast<char*>(nullptr);
+    errno = 0;
+    auto number = std::strtoul(value, &end, 10);
+    if (0 != errno || '\0' != *end || number < min || number > max)
+	return false;
+
+    result = number;
+    return true;
+}
+
+bool Options::verbose() { return optionStore.verbose; }
 bool Options::saveTemps() { return optionStore.saveTemps; }
+bool Options::cache() { return !optionStore.noCache; }
+bool Options::cacheGc() { return optionStore.cacheGc; }
+bool Options::unity() { return optionStore.unity; }
+bool Options::time() { return optionStore.time; }
+const std::string& Options::trace() { return optionStore.trace; }
+bool Options::rusage() { return optionStore.rusage; }
+const std::string& Options::rusageFile() { return optionStore.rusageFile; }
+unsigned Options::bench() { return optionStore.bench; }
+unsigned Options::benchWarmup() { return optionStore.benchWarmup; }
+int Options::benchCpu() { return int(optionStore.benchCpu) - 1; }
+const std::string& Options::benchInput() { return optionStore.benchInput; }
 const std::string& Options::commandName() { return optionStore.commandName; }
 const std::string& Options::cxx() { return optionStore.cxx; }
 const std::string& Options::debugger() { return optionStore.debugger; }
 const std::string& Options::executable() { return optionStore.executable; }
 const std::string& Options::optimization() { return optionStore.optimization; }
 
+unsigned Options::jobs()
+{
+    if (0 == optionStore.jobs) {
+	auto cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	optionStore.jobs = cpus > 0 ? cpus : 1;
+    }
+
+    return optionStore.jobs;
+}
+
+std::uint64_t Options::cacheSize()
+{
+    if (0 == optionStore.cacheSize)
+	optionStore.cacheSize = UINT64_C(1) << 30;
+    return optionStore.cacheSize;
+}
+
+unsigned Options::cacheAge()
+{
+    if (0 == optionStore.cacheAge)
+	optionStore.cacheAge = 30;
+    return optionStore.cacheAge;
+}
+
 void Options::handleArg0(const std::string& arg)
 {
     optionStore.commandName = arg;
@@ -63,6 +160,80 @@ bool Options::checkArgument(const std::string& arg)
 	return true;
     }
 
+    if (arg == "--hbcxx-no-cache") {
+	optionStore.noCache = true;
+	return true;
+    }
+
+    if (arg == "--hbcxx-cache-gc") {
+	optionStore.cacheGc = true;
+	return true;
+    }
+
+    if (arg == "--hbcxx-unity") {
+	optionStore.unity = true;
+	return true;
+    }
+
+    if (arg == "--hbcxx-time") {
+	optionStore.time = true;
+	return true;
+    }
+
+    if (arg == "--hbcxx-rusage") {
+	optionStore.rusage = true;
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-rusage=")) {
+	optionStore.rusageFile = arg.substr(sizeof("--hbcxx-rusage=")-1);
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-trace=")) {
+	optionStore.trace = arg.substr(sizeof("--hbcxx-trace=")-1);
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-cache-age=")) {
+	// the age is converted to nanoseconds so it must be well short of
+	// 213503 days (the most that fits in 64 bits)
+	auto days = 0ul;
+	if (!parseNumber(arg.c_str() + sizeof("--hbcxx-cache-age=")-1, 1,
+	                 100000, days))
+	    return badValue(arg);
+	optionStore.cacheAge = days;
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-cache-size=")) {
+	auto value = arg.c_str() + sizeof("--hbcxx-cache-size=")-1;
+	if (!std::isdigit(static_cast<unsigned char>(*value)))
+	    return badValue(arg);
+
+	auto end = static_cast<char*>(nullptr);
+	errno = 0;
+	auto size = std::strtoull(value, &end, 10);
+	auto shift = 0;
+	switch (*end) {
+	case 'G':
+	    shift += 10;
+	    // fall through
+	case 'M':
+	    shift += 10;
+	    // fall through
+	case 'K':
+	    shift += 10;
+	    end++;
+	    break;
+	}
+	if (0 != errno || '\0' != *end || 0 == size ||
+	    size > (UINT64_MAX >> shift))
+	    return badValue(arg);
+	optionStore.cacheSize = std::uint64_t(size) << shift;
+	return true;
+    }
+
     if (starts_with(arg, "--hbcxx-cxx=")) {
 	optionStore.cxx = arg.substr(sizeof("--hbcxx-cxx=")-1);
 	return true;
@@ -78,6 +249,48 @@ bool Options::checkArgument(const std::string& arg)
 	return true;
     }
 
+    if (starts_with(arg, "--hbcxx-bench=")) {
+	auto runs = 0ul;
+	if (!parseNumber(arg.c_str() + sizeof("--hbcxx-bench=")-1, 1,
+	                 UINT_MAX, runs))
+	    return badValue(arg);
+	optionStore.bench = runs;
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-bench-warmup=")) {
+	auto runs = 0ul;
+	if (!parseNumber(arg.c_str() + sizeof("--hbcxx-bench-warmup=")-1, 0,
+	                 UINT_MAX, runs))
+	    return badValue(arg);
+	optionStore.benchWarmup = runs;
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-bench-cpu=")) {
+	// stored plus one and read back as an int
+	auto cpu = 0ul;
+	if (!parseNumber(arg.c_str() + sizeof("--hbcxx-bench-cpu=")-1, 0,
+	                 INT_MAX - 1, cpu))
+	    return badValue(arg);
+	optionStore.benchCpu = cpu + 1;
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-bench-input=")) {
+	optionStore.benchInput = arg.substr(sizeof("--hbcxx-bench-input=")-1);
+	return true;
+    }
+
+    if (starts_with(arg, "--hbcxx-jobs=")) {
+	auto jobs = 0ul;
+	if (!parseNumber(arg.c_str() + sizeof("--hbcxx-jobs=")-1, 1,
+	                 UINT_MAX, jobs))
+	    return badValue(arg);
+	optionStore.jobs = jobs;
+	return true;
+    }
+
     if (starts_with(arg, "--hbcxx-O")) {
 	optionStore.optimization = arg.substr(sizeof("--hbcxx-O")-1);
 	return true;
@@ -89,6 +302,7 @@ bool Options::checkArgument(const std::string& arg)
 void Options::parseOptionsFile(const std::string& fname)
 {
     std::ifstream in{fname};
+    parsingOptionsFile = true;
     auto ln = std::string{};
     auto option = std::string{};
     auto lineno = 0;
@@ -113,6 +327,7 @@ void Options::parseOptionsFile(const std::string& fname)
             std::cerr << "WARNING: Bad option at line " << lineno << ": "
                       << ln << '\n';
     }
+    parsingOptionsFile = false;
 }
 
 void Options::showUsage()
@@ -125,11 +340,24 @@ void Options::showUsage()
 << "The following arguments control hbcxx and can be included anywhere on\n"
 << "the command line.\n"
 << '\n'
+<< "  --hbcxx-bench=N         Run the program N times and report timings\n"
+<< "  --hbcxx-bench-cpu=CPU   Pin benchmark runs to CPU\n"
+<< "  --hbcxx-bench-input=FILE Feed FILE to each benchmark run\n"
+<< "  --hbcxx-bench-warmup=N  Run the program N extra (untimed) times first\n"
+<< "  --hbcxx-cache-age=DAYS  Discard cached files unused for DAYS days\n"
+<< "  --hbcxx-cache-gc        Garbage collect the cache, then exit\n"
+<< "  --hbcxx-cache-size=SIZE Limit the cache to SIZE bytes (K, M or G suffix)\n"
 << "  --hbcxx-cxx=COMPILER    User COMPILER to compile and link the program\n"
 << "  --hbcxx-debugger=DBG    Use DBG to debug the program\n"
 << "  --hbcxx-executable=EXE  Write executable file to EXE, then exit\n"
 << "  --hbcxx-help            Show this help, then exit\n"
+<< "  --hbcxx-jobs=N          Run up to N compilers at once\n"
+<< "  --hbcxx-no-cache        Do not use the executable cache\n"
+<< "  --hbcxx-rusage[=FILE]   Report the resources used by each process\n"
 << "  --hbcxx-save-temps      Do not delete temporary files\n"
+<< "  --hbcxx-time            Report the time taken by each phase\n"
+<< "  --hbcxx-trace=FILE      Write a Chrome trace of the build to FILE\n"
+<< "  --hbcxx-unity           Compile all source files as a single unit\n"
 << "  --hbcxx-Ox              Override the optimization level, set to x\n"
 << "  --hbcxx-verbose         Show commands as they are executed\n"
 << "  --hbcxx-version         Show hbcxx version information, then exit\n";
@@ -14,17 +14,61 @@
 #ifndef HBCXX_OPTIONS_H_
 #define HBCXX_OPTIONS_H_
 
+#include <cstdint>
 #include <string>
 
 namespace Options {
 
 bool verbose();
 bool saveTemps();
+bool cache();
 const std::string& commandName();
 const std::string& cxx();
 const std::string& debugger();
 const std::string& executable();
 const std::string& optimization();
+unsigned jobs();
+
+/*!
+ * Limits applied to the ~/.hbcxx store by the garbage collector.
+ */
+std::uint64_t cacheSize();
+unsigned cacheAge();
+
+/*!
+ * Check whether --hbcxx-cache-gc was given.
+ */
+bool cacheGc();
+
+/*!
+ * Check whether --hbcxx-unity was given.
+ */
+bool unity();
+
+/*!
+ * Check whether (and where) --hbcxx-time and --hbcxx-trace= asked for the
+ * phases of the build to be reported.
+ */
+bool time();
+const std::string& trace();
+
+/*!
+ * Check whether --hbcxx-rusage (print the resources used by each child
+ * process) or --hbcxx-rusage=FILE (append them to FILE) was given.
+ */
+bool rusage();
+const std::string& rusageFile();
+
+/*!
+ * Settings for the benchmark launcher.
+ *
+ * bench() is the number of timed runs (0 if --hbcxx-bench= was not given)
+ * and benchCpu() is -1 unless the runs are pinned to a CPU.
+ */
+unsigned bench();
+unsigned benchWarmup();
+int benchCpu();
+const std::string& benchInput();
 
 /*!
  * Maintain a record of how hbcxx itself was launched.
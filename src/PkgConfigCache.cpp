@@ -0,0 +1,281 @@
+/*
+ * PkgConfigCache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "PkgConfigCache.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "hash.h"
+#include "system.h"
+#include "Options.h"
+
+static const char pkgConfigVersion[] = "hbcxx-pkgconfig-1";
+
+namespace {
+
+struct Result {
+    bool ok;
+    std::string flags;
+    std::list<std::string> files;
+};
+
+} // anonymous namespace
+
+static std::map<std::string, Result>& getResults()
+{
+    static std::map<std::string, Result> results;
+    return results;
+}
+
+static std::string getEnv(const char* name)
+{
+    auto value = std::getenv(name);
+    return std::string{value ? "=" : "!"} + (value ? value : "");
+}
+
+/*!
+ * Split a requirement (or a Requires: line) into package names.
+ */
+static std::list<std::string> getPackageNames(const std::string& requires)
+{
+    auto tokens = std::list<std::string>{};
+    boost::split(tokens, requires, boost::is_any_of(" \t,"),
+                 boost::token_compress_on);
+
+    auto names = std::list<std::string>{};
+    auto skipNext = bool{false};
+    for (auto& token : tokens) {
+	if (token.empty())
+	    continue;
+	if (skipNext) {
+	    skipNext = false;
+	    continue;
+	}
+
+	// comparison operators are followed by a version number
+	if (std::string{"<>=!"}.find(token[0]) != std::string::npos) {
+	    skipNext = true;
+	    continue;
+	}
+
+	names.push_back(token);
+    }
+
+    return names;
+}
+
+/*!
+ * Get the directories pkg-config searches for .pc files.
+ */
+static std::list<std::string> getSearchPath()
+{
+    static auto defaultPath = std::string{};
+    static auto hasDefaultPath = bool{false};
+
+    auto path = std::string{};
+    auto append = [&](const std::string& dirs) {
+	if (!path.empty() && !dirs.empty())
+	    path += ':';
+	path += dirs;
+    };
+
+    auto pkgConfigPath = std::getenv("PKG_CONFIG_PATH");
+    if (pkgConfigPath)
+	append(pkgConfigPath);
+
+    auto libdir = std::getenv("PKG_CONFIG_LIBDIR");
+    if (libdir) {
+	append(libdir);
+    } else {
+	if (!hasDefaultPath) {
+	    auto output = std::unique_ptr<std::stringstream>{};
+	    if (0 == hbcxx::system("pkg-config --variable pc_path pkg-config",
+	                           output))
+		std::getline(*output, defaultPath);
+	    hasDefaultPath = true;
+	}
+	append(defaultPath);
+    }
+
+    auto dirs = std::list<std::string>{};
+    boost::split(dirs, path, boost::is_any_of(":"), boost::token_compress_on);
+    dirs.remove(std::string{});
+    return dirs;
+}
+
+bool PkgConfigCache::lookup(const std::string& requires, std::string& flags,
+                            std::list<std::string>& files)
+{
+    auto verbose = Options::verbose();
+    auto& results = getResults();
+
+    // memoized within this process
+    auto i = results.find(requires);
+    if (i != results.end()) {
+	if (verbose)
+	    std::cerr << "hbcxx: pkg-config already queried: " << requires
+	              << '\n';
+	flags = i->second.flags;
+	files.insert(files.end(), i->second.files.begin(),
+	             i->second.files.end());
+	return i->second.ok;
+    }
+
+    // stored in ~/.hbcxx/pkgconfig
+    auto cacheFile = std::string{};
+    auto store = hbcxx::storeDirectory();
+    auto pkgConfig = hbcxx::which("pkg-config");
+    auto pkgConfigStamp = hbcxx::FileStamp{};
+    if (Options::cache() && !store.empty() &&
+        hbcxx::stamp(pkgConfig, pkgConfigStamp)) {
+	auto hash = hbcxx::Hash{};
+	hash.update(std::string{pkgConfigVersion});
+	hash.update(requires);
+	hash.update(pkgConfig);
+	hash.update(&pkgConfigStamp, sizeof(pkgConfigStamp));
+	for (auto var : { "PKG_CONFIG_PATH", "PKG_CONFIG_LIBDIR",
+	                  "PKG_CONFIG_SYSROOT_DIR" })
+	    hash.update(getEnv(var));
+	cacheFile = store + "/pkgconfig/" + hash.hex();
+    }
+
+    if (!cacheFile.empty()) {
+	std::ifstream in{cacheFile};
+	auto result = Result{true, std::string{}, std::list<std::string>{}};
+	auto valid = bool{in.is_open()};
+	auto line = std::string{};
+
+	if (valid && std::getline(in, line) && boost::starts_with(line, "flags "))
+	    result.flags = line.substr(6);
+	else
+	    valid = false;
+
+	while (valid && std::getline(in, line)) {
+	    auto expected = hbcxx::FileStamp{};
+	    auto actual = hbcxx::FileStamp{};
+	    auto fname = std::string{};
+	    std::istringstream fields{line};
+	    fields >> expected.size >> expected.mtime_ns >> std::ws;
+	    std::getline(fields, fname);
+
+	    if (!hbcxx::stamp(fname, actual) || actual.size != expected.size ||
+	        actual.mtime_ns != expected.mtime_ns)
+		valid = false;
+	    result.files.push_back(fname);
+	}
+
+	if (valid) {
+	    if (verbose)
+		std::cerr << "hbcxx: pkg-config cache hit: " << requires
+		          << '\n';
+	    flags = result.flags;
+	    files.insert(files.end(), result.files.begin(), result.files.end());
+	    results.emplace(requires, std::move(result));
+	    return true;
+	}
+    }
+
+    // --cflags and --libs also check any version requirements so a single
+    // query does everything we need
+    auto command = std::string{"pkg-config --print-errors --cflags --libs '"}
+                   + requires + '\'';
+    auto output = std::unique_ptr<std::stringstream>{};
+    if (verbose)
+	std::cerr << "hbcxx: running: " << command << std::endl;
+    auto res = hbcxx::system(command, output);
+
+    auto result = Result{0 == res, boost::trim_copy(output->str()),
+                         std::list<std::string>{}};
+    if (result.ok)
+	result.files = resolve(requires);
+
+    if (result.ok && !cacheFile.empty() && !result.files.empty()) {
+	std::ostringstream out;
+	out << "flags " << result.flags << '\n';
+	for (auto& fname : result.files) {
+	    auto st = hbcxx::FileStamp{};
+	    (void) hbcxx::stamp(fname, st);
+	    out << st.size << ' ' << st.mtime_ns << ' ' << fname << '\n';
+	}
+
+	auto ec = boost::system::error_code{};
+	boost::filesystem::create_directories(store + "/pkgconfig", ec);
+	(void) hbcxx::replaceFile(cacheFile, out.str());
+    }
+
+    flags = result.flags;
+    files.insert(files.end(), result.files.begin(), result.files.end());
+    auto ok = result.ok;
+    results.emplace(requires, std::move(result));
+    return ok;
+}
+
+/*!
+ * Find the .pc files used to satisfy a requirement.
+ *
+ * This mimics the pkg-config search algorithm (the first directory in the
+ * search path that contains a matching .pc file wins) and follows the
+ * Requires: lines of each file found.
+ *
+ * \returns the files found (or an empty list if any package could not
+ *          be found)
+ */
+std::list<std::string> PkgConfigCache::resolve(const std::string& requires)
+{
+    auto searchPath = getSearchPath();
+    auto files = std::list<std::string>{};
+    auto seen = std::set<std::string>{};
+    auto pending = getPackageNames(requires);
+
+    while (!pending.empty()) {
+	auto name = pending.front();
+	pending.pop_front();
+	if (!seen.insert(name).second)
+	    continue;
+
+	auto found = std::string{};
+	for (auto& dir : searchPath) {
+	    auto candidate = dir + '/' + name + ".pc";
+	    auto st = hbcxx::FileStamp{};
+	    if (hbcxx::stamp(candidate, st)) {
+		found = candidate;
+		break;
+	    }
+	}
+	if (found.empty())
+	    return std::list<std::string>{};
+	files.push_back(found);
+
+	std::ifstream in{found};
+	auto line = std::string{};
+	while (std::getline(in, line)) {
+	    if (boost::starts_with(line, "Requires:") ||
+	        boost::starts_with(line, "Requires.private:")) {
+		auto deps = getPackageNames(line.substr(line.find(':') + 1));
+		pending.splice(pending.end(), deps);
+	    }
+	}
+    }
+
+    return files;
+}
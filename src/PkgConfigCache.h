@@ -0,0 +1,49 @@
+/*
+ * PkgConfigCache.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_PKG_CONFIG_CACHE_H_
+#define HBCXX_PKG_CONFIG_CACHE_H_
+
+#include <list>
+#include <string>
+
+/*!
+ * Memoized pkg-config queries.
+ *
+ * Results are remembered for the lifetime of the process and are also
+ * stored in ~/.hbcxx/pkgconfig. The stored results are keyed on the
+ * requirement, the pkg-config environment variables and pkg-config itself
+ * and record the stamp of every .pc file that was used to satisfy the
+ * requirement (including those pulled in by Requires: lines). If any of
+ * these files change the query is run again.
+ */
+class PkgConfigCache {
+public:
+    /*!
+     * Get the compiler and linker flags for a requirement.
+     *
+     * The requirement may include version checks (e.g. "gtk+-3.0 >= 3.0").
+     *
+     * \param files updated with the .pc files used to satisfy the
+     *              requirement
+     * \returns false if pkg-config could not satisfy the requirement (in
+     *          which case pkg-config will already have reported why)
+     */
+    static bool lookup(const std::string& requires, std::string& flags,
+                       std::list<std::string>& files);
+
+private:
+    static std::list<std::string> resolve(const std::string& requires);
+};
+
+#endif // HBCXX_PKG_CONFIG_CACHE_H_
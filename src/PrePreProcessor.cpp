@@ -13,24 +13,24 @@
 
 #include "PrePreProcessor.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
+#include "filesystem.h"
 #include "system.h"
 #include "util.h"
 #include "CompilationUnit.h"
+#include "DirectiveScanner.h"
+#include "DirectoryCache.h"
 #include "Options.h"
-
-#ifdef HAVE_STD_REGEX
-#include <regex>
-namespace re = std;
-#else
-#include <boost/regex.hpp>
-namespace re = boost;
-#endif
+#include "PkgConfigCache.h"
+#include "ScanCache.h"
 
 using hbcxx::ScopeExit;
 namespace file = boost::filesystem;
@@ -38,6 +38,8 @@ namespace file = boost::filesystem;
 PrePreProcessor::PrePreProcessor()
     : _inputFileName{}
     , _lineno{}
+    , _dependencies{}
+    , _stamped{}
 {
 }
 
@@ -45,198 +47,324 @@ PrePreProcessor::~PrePreProcessor()
 {
 }
 
+/*!
+ * Check whether a directive is one that process() knows how to handle.
+ *
+ * The result is recorded in the ScanCache so the cache version must be
+ * changed if new directives are added.
+ */
+static bool isKnownDirective(const std::string& directive)
+{
+    return directive == "cxx" || directive == "private" ||
+           directive == "requires" || directive == "source";
+}
+
+/*!
+ * Find the line number of the last system include in the leading block.
+ *
+ * The leading block is the run of #include <...> directives found before
+ * anything other than whitespace, comments and #! lines. Headers in this
+ * block can be precompiled because nothing in the file can influence how
+ * they are parsed.
+ *
+ * \returns 0 if the file does not start with a system include
+ */
+static std::size_t findLeadingBlock(const char* p, const char* end)
+{
+    auto lineno = std::size_t{1};
+    auto last = std::size_t{0};
+    auto inComment = false;
+
+    auto endOfLine = [&](const char* q) {
+	auto nl = static_cast<const char*>(std::memchr(q, '\n', end - q));
+	return nl ? nl : end;
+    };
+    auto skipBlanks = [&](const char* q, const char* limit) {
+	while (q < limit && (*q == ' ' || *q == '\t' || *q == '\r'))
+	    q++;
+	return q;
+    };
+
+    while (p < end) {
+	if (inComment) {
+	    if (*p == '*' && p + 1 < end && p[1] == '/') {
+		inComment = false;
+		p += 2;
+		continue;
+	    }
+	    if (*p++ == '\n')
+		lineno++;
+	    continue;
+	}
+
+	switch (*p) {
+	case '\n':
+	    lineno++;
+	    // fall through
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\f':
+	case '\v':
+	    p++;
+	    continue;
+
+	case '/':
+	    if (p + 1 < end && p[1] == '*') {
+		inComment = true;
+		p += 2;
+		continue;
+	    }
+	    if (p + 1 < end && p[1] == '/') {
+		p = endOfLine(p);
+		continue;
+	    }
+	    return last;
+
+	case '#': {
+	    auto eol = endOfLine(p);
+	    if (p + 1 < eol && p[1] == '!') {
+		p = eol;
+		continue;
+	    }
+
+	    // the directive must be one the scanner reports (otherwise the
+	    // block would not match the includes that are precompiled)
+	    auto q = DirectiveScanner::matchInclude(p, eol);
+	    if (nullptr == q || q == eol || *q != '<')
+		return last;
+	    auto close = static_cast<const char*>(std::memchr(q, '>', eol - q));
+	    if (!close)
+		return last;
+	    q = skipBlanks(close + 1, eol);
+	    if (q != eol && !(q + 1 < eol && q[0] == '/' && q[1] == '/'))
+		return last;
+
+	    last = lineno;
+	    p = eol;
+	    continue;
+	}
+
+	default:
+	    return last;
+	}
+    }
+
+    return last;
+}
+
+/*!
+ * Find everything of interest within a file.
+ *
+ * The result depends only on the contents of the file (which means it can
+ * be cached).
+ */
+static ScanResult scan(const hbcxx::MappedFile& buffer)
+{
+    auto result = ScanResult{};
+    auto add = [&](ScanEvent::Kind kind, std::size_t line,
+                   std::size_t column, std::string name, std::string text) {
+	result.push_back(ScanEvent{kind, line, column, false, std::move(name),
+	                           std::move(text)});
+    };
+
+    DirectiveScanner scanner{buffer.begin(), buffer.end()};
+    auto line = ScannedLine{};
+    auto leadingBlock = findLeadingBlock(buffer.begin(), buffer.end());
+
+    while (scanner.next(line)) {
+        hbcxx::poll_signals();
+	auto lineno = line.number;
+
+	// phase 1: make compilable by commenting out the #! directives
+	// (the scanner has already done this for the other phases)
+	auto rewriteOffset = line.rewriteOffset;
+	if (rewriteOffset != ScannedLine::npos)
+	    rewriteOffset += line.original.begin - buffer.begin();
+
+	// phase 2: track whether a hash bang directive has been processed
+	auto pendingDirective = line.hasHashBang;
+
+	// phase 3: process raw flags
+	if (pendingDirective && line.hasFlags) {
+	    pendingDirective = false;
+	    add(ScanEvent::Flags, lineno, 0, std::string{}, line.flags.str());
+	}
+
+	// phase 4: process directives
+	if (pendingDirective && line.hasDirective) {
+	    auto directive = line.directiveName.str();
+	    if (isKnownDirective(directive)) {
+		pendingDirective = false;
+		add(ScanEvent::Directive, lineno, 0, directive,
+		    line.directiveValue.str());
+	    }
+	}
+
+	// phase 5: identify local includes
+	if (line.include == ScannedLine::LocalInclude)
+	    add(ScanEvent::LocalInclude, lineno, 0, std::string{},
+	        line.includeFile.str());
+
+	// phase 6: identify "magic" includes
+	if (line.include == ScannedLine::SystemInclude) {
+	    add(ScanEvent::SystemInclude, lineno, 0, std::string{},
+	        line.includeFile.str());
+	    result.back().leading = lineno <= leadingBlock;
+	}
+
+	// phase 7: identify interpreter directives
+	if (pendingDirective && line.hasInterpreter)
+	    pendingDirective = false;
+
+	// phase 8: error reporting
+	if (pendingDirective)
+	    add(ScanEvent::Unknown, lineno, line.hashBangColumn, std::string{},
+	        line.hashBangText.str());
+
+	if (rewriteOffset != ScannedLine::npos)
+	    add(ScanEvent::Rewrite, lineno, rewriteOffset, std::string{},
+	        std::string{});
+    }
+
+    return result;
+}
+
 std::list<CompilationUnit> PrePreProcessor::process(CompilationUnit& unit)
 {
     auto extraUnits = std::list<CompilationUnit>{};
     auto failed = bool{false};
     auto origInputFileName = _inputFileName; // process() can recurse
     _inputFileName = unit.getInputFileName();
-    std::ifstream in{_inputFileName};
-    std::ostringstream out{};
+    addDependency(_inputFileName);
 
     if (Options::verbose())
         std::cerr << "hbcxx: prepreprocessing: " << _inputFileName << '\n';
 
-    auto rawHashBangRegex = re::regex{"^([ \t]*)(#!)"};
-    auto hashBangRegex = re::regex{"^(.*)//#![ \t]*(.*)$"};
-    auto interpreterRegex = re::regex{"//#![ \t]*/"};
-    auto flagsRegex = re::regex{"//#![ \t]*(-.*)$"};
-    auto directiveRegex = re::regex{"//#![ \t]*([a-zA-Z_]*)[ \t]*:[ \t]*(.*)$"};
-    auto localIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*\"([^\"]*)\""};
-    auto systemIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*<([^\"]*)>"};
-
-    auto line = std::string{};
-    auto origline = line;
-    auto match = re::smatch{};
-    bool rewrite = false;
+    // only files that have changed need to be scanned (and they are
+    // scanned in place without copying them)
+    auto events = ScanResult{};
+    ScanCache cache{_inputFileName};
+    if (!cache.lookup(events)) {
+	hbcxx::MappedFile buffer{_inputFileName};
+	events = scan(buffer);
+	cache.store(events, buffer);
+    }
 
-    _lineno = 0;
-    out << "#line 1 \"" << _inputFileName << "\"\n";
+    auto rewrites = std::vector<std::size_t>{};
 
-    while (in.good()) {
+    for (auto& event : events) {
         hbcxx::poll_signals();
-
-        std::getline(in, origline);
-	_lineno += 1;
+	_lineno = event.line;
 
 	try {
-            // phase 1: make compilable by commenting out the #! directives
-            line = re::regex_replace(origline, rawHashBangRegex, "$1//$2");
-
-            // phase 2: track whether a hash bang directive has been processed
-            auto pendingDirective
-                = re::regex_search(line, match, hashBangRegex);
-            if (pendingDirective) {
-		auto leadIn = std::string{match[1]};
-                auto count
-                    = std::count_if(std::begin(leadIn), std::end(leadIn),
-                                    [](char c) { return c == '"'; });
-		// if there are an odd number of double quotes prior to the
-		// directive we assume that the directive appears within a
-		// string
-		if (count & 1)
-		    pendingDirective = false;
-            }
-
-            // phase 3: process raw flags
-            if (pendingDirective && re::regex_search(line, match, flagsRegex)) {
-                pendingDirective = false;
-
+	    switch (event.kind) {
+	    case ScanEvent::Flags:
 		if (Options::verbose())
-		    std::cerr << "hbcxx: found " << match[1] << '\n';
-                unit.pushFlags(match[1]);
-            }
-
-            // phase 4: process directives
-            if (pendingDirective
-                && re::regex_search(line, match, directiveRegex)) {
-                pendingDirective = false;
-
-                auto directive = match[1];
-                auto value = match[2];
-		if (directive == "cxx")
-		    unit.pushFlags(std::string{"--hbcxx-cxx="} + value);
-                else if (directive == "private")
-                    unit.pushPrivateFlags(value);
-                else if (directive == "requires")
-                    unit.pushFlags(handleRequires(value));
-                else if (directive == "source")
-                    extraUnits.emplace_back(handleSourceDirective(value));
-                else
-                    pendingDirective = true; // didn't consume it after all
-            }
-
-            // phase 5: identify local includes
-            if (re::regex_search(line, match, localIncludeRegex)) {
-                auto includeFile = match[1];
-
-                auto headerPath = file::path{includeFile};
+		    std::cerr << "hbcxx: found " << event.text << '\n';
+                unit.pushFlags(event.text);
+		break;
+
+	    case ScanEvent::Directive:
+		if (event.name == "cxx")
+		    unit.pushFlags(std::string{"--hbcxx-cxx="} + event.text);
+                else if (event.name == "private")
+                    unit.pushPrivateFlags(event.text);
+                else if (event.name == "requires")
+                    unit.pushFlags(handleRequires(event.text));
+                else if (event.name == "source")
+                    extraUnits.emplace_back(handleSourceDirective(event.text));
+		break;
+
+	    case ScanEvent::LocalInclude: {
+		unit.setHasLocalIncludes(true);
+                auto headerPath = file::path{event.text};
 		if (headerPath.is_relative())
                     headerPath = file::path{_inputFileName}.parent_path()
                                  / headerPath;
+		addDependency(headerPath.string());
 		if (file::exists(headerPath))
                     extraUnits.emplace_back(headerPath.string(),
                                             CompilationUnit::HeaderFile);
 
-                auto sourceFile = findSourceFile(includeFile);
+                auto sourceFile = findSourceFile(event.text);
                 if (!sourceFile.empty())
                     extraUnits.emplace_back(sourceFile);
-            }
+		break;
+	    }
 
-            // phase 6: identify "magic" includes
-            if (re::regex_search(line, match, systemIncludeRegex)) {
-                auto includeFile = match[1];
-                auto extraFlags = checkForMagicIncludes(includeFile);
+	    case ScanEvent::SystemInclude: {
+                auto extraFlags = checkForMagicIncludes(event.text);
                 if (!extraFlags.empty())
                     unit.pushFlags(extraFlags);
-            }
-
-	    // phase 7: identify interpreter directives
-	    if (pendingDirective && re::regex_search(line, interpreterRegex)) {
-                pendingDirective = false;
+		if (event.leading)
+		    unit.pushLeadingInclude(event.text);
+		break;
 	    }
 
-
-            // phase 8: error reporting
-            if (pendingDirective) {
-                auto found = re::regex_search(line, match, hashBangRegex);
-                // we are *re*matching so this cannot fail
-		assert(found == true);
+	    case ScanEvent::Unknown:
                 std::cerr << _inputFileName << ':' << _lineno << ":"
-                          << std::string{match[1]}.size() + 1
-                          << ": error: unknown directive: " << match[2]
-                          << std::endl;
+                          << event.column << ": error: unknown directive: "
+                          << event.text << std::endl;
                 failed = true;
-            }
+		break;
+
+	    case ScanEvent::Rewrite:
+		rewrites.push_back(event.column);
+		if (unit.getIsHeader()) {
+		    std::cerr << _inputFileName << ':' << _lineno
+		              << ":1: error: header files cannot be rewritten\n";
+		    failed = true;
+		}
+		break;
+	    }
         }
 	catch (PrePreProcessorError& e) {
 	    // contain the error until pre-pre-processing is complete
 	    failed = true;
 	}
-
-	if (line != origline) {
-            rewrite = true;
-
-	    if (unit.getIsHeader()) {
-                std::cerr << _inputFileName << ':' << _lineno
-                          << ":1: error: header files cannot be rewritten\n";
-		failed = true;
-            }
-        }
-
-        out << line << '\n';
     }
 
     if (failed)
 	throw PrePreProcessorError{};
 
-    if (rewrite) {
-	auto fp = unit.openProcessedFile();
-        *fp << out.str();
-        if (Options::verbose())
-            std::cerr << "hbcxx: wrote pre-pre-processor output to: "
-                      << unit.getProcessedFileName() << '\n';
-    }
+    // the rewrite itself is deferred until the unit is compiled (and
+    // will not be written to disk at all if the compiler can read it from
+    // a pipe)
+    unit.setRewrites(std::move(rewrites));
 
     _inputFileName = origInputFileName;
     return extraUnits;
 }
 
-std::string PrePreProcessor::handleRequires(const std::string& requires)
+const std::list<hbcxx::StampedFile>& PrePreProcessor::getDependencies() const
 {
+    return _dependencies;
+}
 
-    auto versionCheck = std::string{
-        "pkg-config --print-errors --exists '"} + requires + '\'';
-    auto versionOutput = std::unique_ptr<std::stringstream>{};
-    if (Options::verbose())
-	std::cerr << "hbcxx: running: " << versionCheck << std::endl;
-    auto versionRes = hbcxx::system(versionCheck, versionOutput);
-    if (0 != versionRes) {
-        std::cerr << _inputFileName << ':' << _lineno
-                  << ":1: error: pkg-config failed\n";
-	std::cerr << "     requires: " << requires << std::endl;
-        std::cerr << versionOutput->str(); // usually this is empty but just in case...
-	throw PrePreProcessorError{};
-    }
-
-    // make a copy of requires removing any version number checks
-    auto versionCheckRegex = re::regex{"[ \t]+[><=]=[ \t]+[^ \t]+"};
-    auto cleanRequires = re::regex_replace(requires, versionCheckRegex, "");
+void PrePreProcessor::addDependency(const std::string& fname)
+{
+    // only the first stamp matters; it was taken before anything was read
+    auto absolute = file::absolute(fname).string();
+    if (_stamped.insert(absolute).second)
+	_dependencies.push_back(hbcxx::stampFile(absolute));
+}
 
-    auto command = std::string{"pkg-config --cflags --libs "} + cleanRequires;
-    auto output = std::unique_ptr<std::stringstream>{};
-    if (Options::verbose())
-	std::cerr << "hbcxx: running: " << command << std::endl;
-    int res = hbcxx::system(command, output);
-    if (0 != res) {
+std::string PrePreProcessor::handleRequires(const std::string& requires)
+{
+    auto flags = std::string{};
+    auto files = std::list<std::string>{};
+    auto ok = PkgConfigCache::lookup(requires, flags, files);
+    for (auto& fname : files)
+	addDependency(fname);
+    if (!ok) {
         std::cerr << _inputFileName << ':' << _lineno
-                  << ":1: internal error: pkg-config failed unexpectedly\n";
+                  << ":1: error: pkg-config failed\n";
 	std::cerr << "     requires: " << requires << std::endl;
-        std::cerr << output->str(); // usually this is empty but just in case...
 	throw PrePreProcessorError{};
     }
 
-    return output->str();
+    return flags;
 }
 
 std::string PrePreProcessor::handleSourceDirective(const std::string& source)
@@ -265,7 +393,8 @@ std::string PrePreProcessor::findSourceFile(const std::string& header)
     for (auto extension : { ".cpp", ".c++", ".C", ".cc", ".c" }) {
 	auto sourcePath = stemPath;
 	sourcePath += file::path{extension};
-	if (file::exists(sourcePath)) {
+	addDependency(sourcePath.string());
+	if (DirectoryCache::exists(sourcePath.string())) {
             return sourcePath.native();
 	}
     }
@@ -15,8 +15,11 @@
 #define HBCXX_PRE_PRE_PROCESSOR_H_
 
 #include <list>
+#include <set>
 #include <string>
 
+#include "filesystem.h"
+
 class CompilationUnit;
 
 class PrePreProcessor {
@@ -26,7 +29,18 @@ public:
 
     std::list<CompilationUnit> process(CompilationUnit& unit);
 
+    /*!
+     * Get every file examined by process().
+     *
+     * This includes files that were probed for but found not to exist
+     * (since creating them would alter the result of pre-pre-processing).
+     * Each file is stamped before it is first examined so that a file
+     * modified during the build cannot be mistaken for the one we read.
+     */
+    const std::list<hbcxx::StampedFile>& getDependencies() const;
+
 private:
+    void addDependency(const std::string& fname);
     std::string handleRequires(const std::string& requires);
     std::string handleSourceDirective(const std::string& requires);
     std::string findSourceFile(const std::string& header);
@@ -34,6 +48,8 @@ private:
 
     std::string _inputFileName;
     int _lineno;
+    std::list<hbcxx::StampedFile> _dependencies;
+    std::set<std::string> _stamped;
 };
 
 class PrePreProcessorError : public std::exception {
@@ -0,0 +1,139 @@
+/*
+ * ProcessedSource.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "ProcessedSource.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include "system.h"
+
+static const char commentOut[] = "//";
+static const char newline[] = "\n";
+
+/*!
+ * Make an iovec for a span of read-only memory.
+ */
+static struct iovec makeSpan(const char* base, std::size_t len)
+{
+    auto span = iovec{};
+    span.iov_base = const_cast<char*>(base);
+    span.iov_len = len;
+    return span;
+}
+
+ProcessedSource::ProcessedSource()
+    : _file{}
+    , _lineMarker{}
+    , _spans{}
+    , _size{0}
+{
+}
+
+ProcessedSource::~ProcessedSource()
+{
+}
+
+bool ProcessedSource::open(const std::string& fname,
+                           const std::vector<std::size_t>& offsets)
+{
+    _spans.clear();
+    _size = 0;
+
+    auto file = std::make_shared<const hbcxx::MappedFile>(fname);
+    if (!file->isOpen())
+	return false;
+    _file = file;
+    _lineMarker = std::make_shared<const std::string>(
+        std::string{"#line 1 \""} + fname + "\"\n");
+
+    _spans.push_back(makeSpan(_lineMarker->data(), _lineMarker->size()));
+    auto done = std::size_t{0};
+    for (auto offset : offsets) {
+	if (offset > file->size()) {
+	    _spans.clear(); // the file changed underneath us
+	    return false;
+	}
+	_spans.push_back(makeSpan(file->begin() + done, offset - done));
+	_spans.push_back(makeSpan(commentOut, sizeof(commentOut) - 1));
+	done = offset;
+    }
+    _spans.push_back(makeSpan(file->begin() + done, file->size() - done));
+    _spans.push_back(makeSpan(newline, sizeof(newline) - 1));
+
+    for (auto& span : _spans)
+	_size += span.iov_len;
+    return true;
+}
+
+void ProcessedSource::updateHash(hbcxx::Hash& hash) const
+{
+    for (auto& span : _spans)
+	hash.update(span.iov_base, span.iov_len);
+}
+
+bool ProcessedSource::write(int fd, std::size_t& offset) const
+{
+    while (offset < _size) {
+	// find the span containing offset
+	auto first = _spans.begin();
+	auto skip = offset;
+	while (skip >= first->iov_len) {
+	    skip -= first->iov_len;
+	    ++first;
+	}
+
+	auto count = std::min<std::size_t>(_spans.end() - first, IOV_MAX);
+	auto spans = std::vector<struct iovec>(first, first + count);
+	spans.front().iov_base = static_cast<char*>(spans.front().iov_base)
+	                         + skip;
+	spans.front().iov_len -= skip;
+
+	auto len = ::writev(fd, spans.data(), static_cast<int>(spans.size()));
+	if (len < 0) {
+	    if (EINTR == errno)
+		continue;
+	    return EAGAIN == errno || EWOULDBLOCK == errno;
+	}
+	offset += static_cast<std::size_t>(len);
+    }
+
+    return true;
+}
+
+bool ProcessedSource::writeFile(const std::string& fname) const
+{
+    auto tmpname = fname + hbcxx::unique();
+
+    auto fd = ::open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0666);
+    if (-1 == fd)
+	return false;
+
+    auto offset = std::size_t{0};
+    auto ok = write(fd, offset) && offset == _size;
+    if (0 != ::close(fd))
+	ok = false;
+
+    if (!ok || 0 != std::rename(tmpname.c_str(), fname.c_str())) {
+	(void) std::remove(tmpname.c_str());
+	return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,80 @@
+/*
+ * ProcessedSource.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_PROCESSED_SOURCE_H_
+#define HBCXX_PROCESSED_SOURCE_H_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+#include "hash.h"
+
+/*!
+ * The rewritten form of a source file.
+ *
+ * The rewritten source is never assembled in memory. Instead it is
+ * described as a sequence of spans of the (mapped) original file
+ * interleaved with the "//" patches that comment out its #! lines, so
+ * memory use does not grow with the size of the file.
+ *
+ * Copies share the mapping of the original file.
+ */
+class ProcessedSource {
+public:
+    ProcessedSource();
+    ~ProcessedSource();
+
+    /*!
+     * Describe fname, starting with a #line marker, with "//" inserted at
+     * each of the offsets (which must be in ascending order).
+     *
+     * \returns false if the file cannot be read (or no longer contains
+     *          all of the offsets)
+     */
+    bool open(const std::string& fname,
+              const std::vector<std::size_t>& offsets);
+
+    bool empty() const { return _spans.empty(); }
+    std::size_t size() const { return _size; }
+
+    void updateHash(hbcxx::Hash& hash) const;
+
+    /*!
+     * Write the source to a file descriptor, starting offset bytes in.
+     *
+     * Writes until everything has been written or, for a non-blocking
+     * descriptor, until the descriptor would block. offset is advanced
+     * past whatever was written.
+     *
+     * \returns false on error (with errno set)
+     */
+    bool write(int fd, std::size_t& offset) const;
+
+    /*!
+     * Atomically create (or replace) a file containing the source.
+     */
+    bool writeFile(const std::string& fname) const;
+
+private:
+    std::shared_ptr<const hbcxx::MappedFile> _file;
+    std::shared_ptr<const std::string> _lineMarker;
+    std::vector<struct iovec> _spans;
+    std::size_t _size;
+};
+
+#endif // HBCXX_PROCESSED_SOURCE_H_
@@ -0,0 +1,190 @@
+/*
+ * ScanCache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "ScanCache.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "hash.h"
+#include "Options.h"
+
+namespace file = boost::filesystem;
+
+static const char scanVersion[] = "hbcxx-scan-3";
+
+/*!
+ * Files modified very recently might be modified again (within the
+ * timestamp granularity) without their stamp changing.
+ */
+static bool isTooNew(const hbcxx::FileStamp& st)
+{
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return st.mtime_ns > std::uint64_t(now) - UINT64_C(2000000000);
+}
+
+static char encodeKind(ScanEvent::Kind kind)
+{
+    return "FDULSR"[kind];
+}
+
+static bool decodeKind(char c, ScanEvent::Kind& kind)
+{
+    auto kinds = std::string{"FDULSR"};
+    auto i = kinds.find(c);
+    if (std::string::npos == i)
+	return false;
+
+    kind = static_cast<ScanEvent::Kind>(i);
+    return true;
+}
+
+ScanCache::ScanCache(const std::string& fname)
+    : _fileName{fname}
+    , _absoluteName{}
+    , _cacheFileName{}
+{
+    if (!Options::cache())
+	return;
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return;
+
+    _absoluteName = file::absolute(fname).string();
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{scanVersion});
+    hash.update(_absoluteName);
+    _cacheFileName = store + "/scan/" + hash.hex();
+}
+
+ScanCache::~ScanCache()
+{
+}
+
+bool ScanCache::lookup(ScanResult& result)
+{
+    if (_cacheFileName.empty())
+	return false;
+
+    auto verbose = Options::verbose();
+    auto miss = [&](const char* reason) {
+	if (verbose)
+	    std::cerr << "hbcxx: scan cache miss: " << _fileName << ": "
+	              << reason << '\n';
+	return false;
+    };
+
+    std::ifstream in{_cacheFileName};
+    auto version = std::string{};
+    auto name = std::string{};
+    auto expected = hbcxx::FileStamp{};
+    auto hash = std::string{};
+    std::getline(in, version);
+    std::getline(in, name);
+    in >> expected.dev >> expected.ino >> expected.size >> expected.mtime_ns
+       >> hash;
+    if (in.fail() || version != scanVersion || name != _absoluteName)
+	return miss("not scanned yet");
+
+    auto actual = hbcxx::FileStamp{};
+    if (!hbcxx::stamp(_fileName, actual))
+	return miss("cannot stat");
+
+    auto restamp = bool{false};
+    if (actual != expected || isTooNew(actual)) {
+	hbcxx::MappedFile contents{_fileName};
+	if (!contents.isOpen())
+	    return miss("cannot read");
+
+	auto h = hbcxx::Hash{};
+	h.update(contents.begin(), contents.size());
+	if (h.hex() != hash)
+	    return miss("contents have changed");
+	restamp = actual != expected;
+    }
+
+    result.clear();
+    auto line = std::string{};
+    std::getline(in, line); // discard the remainder of the stamp line
+    while (std::getline(in, line)) {
+	auto event = ScanEvent{ScanEvent::Flags, 0, 0, false, std::string{},
+	                       std::string{}};
+	std::istringstream fields{line};
+	auto kind = char{};
+	fields >> kind >> event.line >> event.column >> event.leading;
+	if (fields.fail() || !decodeKind(kind, event.kind))
+	    return miss("corrupt entry");
+	fields.ignore(1);
+
+	// names can be empty (and never contain colons), text can contain
+	// anything except newlines
+	if (event.kind == ScanEvent::Directive)
+	    std::getline(fields, event.name, ':');
+	std::getline(fields, event.text);
+
+	result.push_back(std::move(event));
+    }
+
+    if (verbose)
+	std::cerr << "hbcxx: scan cache hit: " << _fileName << '\n';
+
+    // the file has been touched (or copied) without changing its contents
+    if (restamp) {
+	hbcxx::MappedFile contents{_fileName};
+	store(result, contents);
+    }
+
+    return true;
+}
+
+void ScanCache::store(const ScanResult& result,
+                      const hbcxx::MappedFile& contents)
+{
+    if (_cacheFileName.empty() || !contents.isOpen())
+	return;
+
+    auto ec = boost::system::error_code{};
+    file::create_directories(file::path{_cacheFileName}.parent_path(), ec);
+    if (ec)
+	return;
+
+    // an untrustworthy stamp is recorded as zeros to force the contents
+    // to be hashed when the entry is next used
+    auto st = hbcxx::FileStamp{};
+    if (!hbcxx::stamp(_fileName, st) || isTooNew(st))
+	st = hbcxx::FileStamp{};
+
+    auto hash = hbcxx::Hash{};
+    hash.update(contents.begin(), contents.size());
+
+    std::ostringstream out;
+    out << scanVersion << '\n'
+        << _absoluteName << '\n'
+        << st.dev << ' ' << st.ino << ' ' << st.size << ' ' << st.mtime_ns
+        << ' ' << hash.hex() << '\n';
+    for (auto& event : result) {
+	out << encodeKind(event.kind) << ' ' << event.line << ' '
+	    << event.column << ' ' << event.leading << ' ';
+	if (event.kind == ScanEvent::Directive)
+	    out << event.name << ':';
+	out << event.text << '\n';
+    }
+
+    (void) hbcxx::replaceFile(_cacheFileName, out.str());
+}
@@ -0,0 +1,86 @@
+/*
+ * ScanCache.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_SCAN_CACHE_H_
+#define HBCXX_SCAN_CACHE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+
+/*!
+ * Something the pre-pre-processor found whilst scanning a file.
+ */
+struct ScanEvent {
+    enum Kind {
+	Flags,         //!< raw flags (text)
+	Directive,     //!< a known directive (name: text)
+	Unknown,       //!< an unknown directive (reported at column)
+	LocalInclude,  //!< #include "text"
+	SystemInclude, //!< #include <text>
+	Rewrite        //!< insert "//" at offset to comment out a #! line
+    };
+
+    Kind kind;
+    std::size_t line;
+    std::size_t column; //!< column (Unknown) or offset (Rewrite)
+    bool leading;       //!< SystemInclude is part of the leading block
+    std::string name;
+    std::string text;
+};
+
+/*!
+ * Everything the pre-pre-processor found in a file, in the order found.
+ *
+ * The result of a scan depends only on the contents of the file. Acting on
+ * the events (which depends on the filesystem and pkg-config) is left to
+ * the pre-pre-processor.
+ */
+typedef std::vector<ScanEvent> ScanResult;
+
+/*!
+ * Persistent store of scan results, kept in ~/.hbcxx/scan.
+ *
+ * Results are stored per file, indexed by its absolute path. A result is
+ * reused if the file's stamp has not changed or, failing that, if the hash
+ * of its contents has not changed.
+ */
+class ScanCache {
+public:
+    explicit ScanCache(const std::string& fname);
+    ~ScanCache();
+
+    /*!
+     * Look for a previous scan of the file.
+     */
+    bool lookup(ScanResult& result);
+
+    /*!
+     * Record the scan of the file.
+     *
+     * \param contents the contents that were scanned
+     */
+    void store(const ScanResult& result, const hbcxx::MappedFile& contents);
+
+private:
+    ScanCache(const ScanCache&);
+    ScanCache& operator=(const ScanCache&);
+
+    std::string _fileName;
+    std::string _absoluteName;
+    std::string _cacheFileName;
+};
+
+#endif // HBCXX_SCAN_CACHE_H_
@@ -0,0 +1,279 @@
+/*
+ * StoreManager.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "StoreManager.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "string.h"
+#include "system.h"
+#include "util.h"
+#include "Options.h"
+
+namespace file = boost::filesystem;
+
+static const std::uint64_t second = UINT64_C(1000000000);
+
+//! interval between background collections
+static const std::uint64_t collectionInterval = 60 * 60 * second;
+
+//! files used more recently than this are kept regardless of size
+static const std::uint64_t gracePeriod = 10 * 60 * second;
+
+namespace {
+
+struct Candidate {
+    std::uint64_t accessed;
+    std::uint64_t size;
+    std::string fname;
+};
+
+} // anonymous namespace
+
+static std::uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::uint64_t toNanoseconds(const struct timespec& t)
+{
+    return std::uint64_t(t.tv_sec) * second + t.tv_nsec;
+}
+
+/*!
+ * Extract the pid from a name generated using hbcxx::unique() on this host.
+ *
+ * \returns the pid or zero if the name is not a temporary file (or belongs
+ *          to a process on another host)
+ */
+static pid_t getTemporaryOwner(const std::string& name)
+{
+    static const auto marker = "-hbcxx-" + hbcxx::hostName() + '-';
+
+    auto i = name.rfind(marker);
+    if (std::string::npos == i)
+	return 0;
+
+    // the pid can only be followed by an extension (such as .d)
+    auto start = name.c_str() + i + marker.size();
+    auto end = static_cast<char*>(nullptr);
+    auto pid = std::strtol(start, &end, 10);
+    if (end == start || ('\0' != *end && '.' != *end))
+	return 0;
+    return pid > 0 ? static_cast<pid_t>(pid) : 0;
+}
+
+static bool isRunning(pid_t pid)
+{
+    return 0 == ::kill(pid, 0) || errno != ESRCH;
+}
+
+/*!
+ * Check whether a lock file is held by a running build.
+ */
+static bool isLocked(const std::string& fname)
+{
+    auto fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+    if (-1 == fd)
+	return false;
+
+    auto locked = 0 != ::flock(fd, LOCK_EX | LOCK_NB);
+    (void) ::close(fd);
+    return locked;
+}
+
+bool StoreManager::collect(Statistics& stats)
+{
+    stats = Statistics{0, 0, 0, 0};
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return false;
+
+    auto ec = boost::system::error_code{};
+    file::create_directories(store, ec);
+
+    // only one collection runs at a time (the lock is released when the
+    // file is closed)
+    auto lockFile = store + "/gc.lock";
+    auto lock = ::open(lockFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (-1 == lock)
+	return false;
+    hbcxx::ScopeExit unlock{[&] { (void) ::close(lock); }};
+    if (0 != ::flock(lock, LOCK_EX | LOCK_NB))
+	return false;
+
+    auto stampFile = store + "/gc.stamp";
+    (void) hbcxx::touch(stampFile);
+    (void) ::utimensat(AT_FDCWD, stampFile.c_str(), nullptr, 0);
+
+    auto verbose = Options::verbose();
+    auto currentTime = now();
+    auto ageLimit = std::uint64_t(Options::cacheAge()) * 24 * 60 * 60 * second;
+    auto oldest = currentTime > ageLimit ? currentTime - ageLimit : 0;
+
+    auto reclaim = [&](const std::string& fname, std::uint64_t size,
+                       const char* reason) {
+	if (0 != ::unlink(fname.c_str()))
+	    return false;
+	if (verbose)
+	    std::cerr << "hbcxx: removed " << fname << " (" << reason << ")\n";
+	stats.reclaimedFiles++;
+	stats.reclaimedBytes += size;
+	return true;
+    };
+
+    auto candidates = std::vector<Candidate>{};
+    auto directories = std::list<std::string>{};
+    auto storePath = file::path{store};
+
+    // the directory iterator cannot continue past an entry that has been
+    // removed so the store is listed before anything is removed
+    auto paths = std::vector<file::path>{};
+    for (auto i = file::recursive_directory_iterator{storePath, ec};
+         !ec && i != file::recursive_directory_iterator{}; i.increment(ec))
+	paths.push_back(i->path());
+
+    for (auto& path : paths) {
+	auto fname = path.string();
+	auto name = path.filename().string();
+	auto isTopLevel = path.parent_path() == storePath;
+
+	struct stat sb;
+	if (0 != ::lstat(fname.c_str(), &sb))
+	    continue;
+
+	if (S_ISDIR(sb.st_mode)) {
+	    if (!isTopLevel)
+		directories.push_front(fname);
+	    continue;
+	}
+	if (!S_ISREG(sb.st_mode))
+	    continue;
+
+	auto size = std::uint64_t(sb.st_size);
+	auto accessed = std::max(toNanoseconds(sb.st_atim),
+	                         toNanoseconds(sb.st_mtim));
+
+	// temporary files left behind by processes (on this host) that were
+	// killed. Those from other hosts are only removed once they are old
+	// enough to be unused.
+	auto owner = getTemporaryOwner(name);
+	if (owner > 0) {
+	    if (!isRunning(owner) && accessed + gracePeriod < currentTime)
+		(void) reclaim(fname, size, "orphaned");
+	    continue;
+	}
+
+	if (isTopLevel)
+	    continue;
+
+	if (boost::ends_with(name, ".lock")) {
+	    if (accessed < oldest && !isLocked(fname))
+		(void) reclaim(fname, size, "unused");
+	    continue;
+	}
+
+	if (accessed < oldest && reclaim(fname, size, "unused"))
+	    continue;
+
+	candidates.push_back(Candidate{accessed, size, fname});
+	stats.files++;
+	stats.bytes += size;
+    }
+
+    // evict the least recently used files until we are within the limit
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) {
+	return a.accessed < b.accessed;
+    });
+    auto limit = Options::cacheSize();
+    for (auto& candidate : candidates) {
+	if (stats.bytes <= limit || candidate.accessed + gracePeriod > currentTime)
+	    break;
+
+	if (reclaim(candidate.fname, candidate.size, "least recently used")) {
+	    stats.files--;
+	    stats.bytes -= candidate.size;
+	}
+    }
+
+    // directories are listed deepest first and rmdir() fails for those that
+    // are not empty
+    for (auto& dir : directories)
+	(void) ::rmdir(dir.c_str());
+
+    return true;
+}
+
+void StoreManager::collectInBackground()
+{
+    if (!Options::cache())
+	return;
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return;
+
+    auto stampFile = store + "/gc.stamp";
+    struct stat sb;
+    if (0 == ::stat(stampFile.c_str(), &sb) &&
+        toNanoseconds(sb.st_mtim) + collectionInterval > now())
+	return;
+
+    // update the stamp now so that concurrent invocations do not all start
+    // a collection
+    (void) hbcxx::touch(stampFile);
+    (void) ::utimensat(AT_FDCWD, stampFile.c_str(), nullptr, 0);
+
+    auto ec = boost::system::error_code{};
+    auto self = file::read_symlink("/proc/self/exe", ec);
+    if (ec)
+	return;
+
+    auto command = std::list<std::string>{
+	self.string(),
+	"--hbcxx-cache-gc",
+	"--hbcxx-cache-size=" + std::to_string(Options::cacheSize()),
+	"--hbcxx-cache-age=" + std::to_string(Options::cacheAge())
+    };
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: starting garbage collection: "
+	          << hbcxx::shjoin(command) << '\n';
+
+    // the shell exits immediately leaving the collector to be adopted by
+    // init (rather than by the program we are about to launch)
+    (void) hbcxx::system(hbcxx::shjoin(command)
+                         + " </dev/null >/dev/null 2>&1 &");
+}
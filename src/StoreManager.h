@@ -0,0 +1,59 @@
+/*
+ * StoreManager.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_STORE_MANAGER_H_
+#define HBCXX_STORE_MANAGER_H_
+
+#include <cstdint>
+
+/*!
+ * Garbage collector for the ~/.hbcxx store.
+ *
+ * Everything hbcxx keeps in the store can be rebuilt so any file can be
+ * removed at any time. The collector removes:
+ *
+ *  - temporary files (those named with hbcxx::unique()) whose process has
+ *    gone (provided they were written by this host and are not recent),
+ *  - files that have not been used for longer than the age limit and
+ *  - the least recently used files until the store is within the size
+ *    limit.
+ *
+ * Files directly within the store (such as hbcxxrc) are never removed.
+ * Files used within the last few minutes are not removed to meet the size
+ * limit because a concurrent build might be about to use them.
+ */
+class StoreManager {
+public:
+    struct Statistics {
+	std::uint64_t files;          //!< files remaining in the store
+	std::uint64_t bytes;          //!< bytes remaining in the store
+	std::uint64_t reclaimedFiles;
+	std::uint64_t reclaimedBytes;
+    };
+
+    /*!
+     * Collect garbage now.
+     *
+     * \returns false if there is no store or another collection is
+     *          already running
+     */
+    static bool collect(Statistics& stats);
+
+    /*!
+     * Start a collection in the background unless one has been started
+     * recently.
+     */
+    static void collectInBackground();
+};
+
+#endif // HBCXX_STORE_MANAGER_H_
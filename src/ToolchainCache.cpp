@@ -0,0 +1,215 @@
+/*
+ * ToolchainCache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "ToolchainCache.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+#include "hash.h"
+#include "string.h"
+#include "system.h"
+#include "Options.h"
+#include "Toolset.h"
+
+namespace file = boost::filesystem;
+
+static const char toolchainVersion[] = "hbcxx-toolchain-2";
+
+ToolchainCache::ToolchainCache()
+    : _fileName{}
+    , _key{calculateKey()}
+    , _command{}
+    , _hasCcache{false}
+    , _compiler{}
+{
+    auto store = hbcxx::storeDirectory();
+    if (!store.empty())
+	_fileName = store + "/toolchain";
+}
+
+ToolchainCache::~ToolchainCache()
+{
+}
+
+bool ToolchainCache::lookup()
+{
+    if (_fileName.empty())
+	return false;
+
+    auto verbose = Options::verbose();
+    auto miss = [&](const char* reason) {
+	if (verbose)
+	    std::cerr << "hbcxx: toolchain cache miss: " << reason << '\n';
+	return false;
+    };
+
+    std::ifstream in{_fileName};
+    if (!in.is_open())
+	return miss("not probed yet");
+
+    auto key = std::string{};
+    auto line = std::string{};
+    while (std::getline(in, line)) {
+	auto space = line.find(' ');
+	auto name = line.substr(0, space);
+	auto value = space == std::string::npos ? std::string{}
+	                                        : line.substr(space + 1);
+
+	if (name == "version" && value != toolchainVersion)
+	    return miss("unknown format");
+	else if (name == "key")
+	    key = value;
+	else if (name == "command")
+	    _command = value;
+	else if (name == "ccache")
+	    _hasCcache = value == "yes";
+	else if (name == "compiler")
+	    _compiler = value;
+    }
+
+    if (key != _key || _command.empty())
+	return miss("toolchain has changed");
+
+    if (verbose)
+	std::cerr << "hbcxx: toolchain cache hit: " << _command << '\n';
+    return true;
+}
+
+void ToolchainCache::probe()
+{
+    _command.clear();
+    _hasCcache = false;
+
+    if (0 == hbcxx::system("ccache --version >/dev/null 2>&1")) {
+	_command += "ccache ";
+	_hasCcache = true;
+    } else {
+	std::cerr << PACKAGE_NAME << ": warning: cannot auto-detect "
+	                             "ccache (build will be slow)\n";
+    }
+
+    auto cxx = std::string{};
+    if (cxx11Check("g++")) {
+	cxx = "g++";
+    } else if (cxx11Check("clang++")) {
+	cxx = "clang++";
+    } else {
+	std::cerr << PACKAGE_NAME
+	          << ": error: cannot auto-detect a C++ compiler\n";
+	throw ToolsetError{};
+    }
+    _command += cxx;
+
+    _compiler = hbcxx::which(cxx);
+
+    if (Options::verbose())
+	std::cerr << "hbcxx: detected toolchain: " << _command << " ("
+	          << _compiler << ")\n";
+
+    save();
+}
+
+const std::string& ToolchainCache::getCommand() const
+{
+    return _command;
+}
+
+bool ToolchainCache::hasCcache() const
+{
+    return _hasCcache;
+}
+
+const std::string& ToolchainCache::getCompiler() const
+{
+    return _compiler;
+}
+
+/*!
+ * Identify the candidate programs using only ::stat().
+ */
+std::string ToolchainCache::calculateKey()
+{
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{toolchainVersion});
+
+    for (auto name : { "ccache", "g++", "clang++" }) {
+	auto path = hbcxx::which(name);
+	auto st = hbcxx::FileStamp{};
+	(void) hbcxx::stamp(path, st);
+
+	hash.update(path);
+	hash.update(&st, sizeof(st));
+    }
+
+    return hash.hex();
+}
+
+bool ToolchainCache::cxx11Check(const std::string& cxx)
+{
+    auto home = std::getenv("HOME");
+    if (nullptr == home)
+	throw ToolsetError{};
+
+    auto stem = file::path{home};
+    stem /= ".hbcxx";
+    // several cold launches may probe at once so the files must be private
+    auto cxxfile = stem / ("cxx11check" + hbcxx::unique() + ".cpp");
+    auto objfile = stem / ("cxx11check" + hbcxx::unique() + ".o");
+
+    (void) file::create_directories(cxxfile.parent_path());
+
+    // this small C++ program exercises three critical C++11 features
+    // (auto types, smart pointers and lambdas) whilst using sufficiently
+    // few templates to allow fast syntax checking.
+    std::ofstream f{cxxfile.native()};
+    f << "#include <memory>\n"
+      << "int main()\n"
+      << "{\n"
+      << "    auto p = std::unique_ptr<int>{new int{0}};\n"
+      << "    auto deref = [&](){ return *p; };\n"
+      << "    return deref();\n"
+      << "}\n";
+    f.close();
+
+    auto args = std::vector<std::string>{ "-std=c++11", "-c", cxxfile.native(),
+                                          "-o", objfile.native() };
+    auto command = cxx + " " + hbcxx::shjoin(args); // + " >/dev/null 2>&1";
+    auto ok = 0 == hbcxx::system(command);
+
+    auto ec = boost::system::error_code{};
+    file::remove(cxxfile, ec);
+    file::remove(objfile, ec);
+    return ok;
+}
+
+void ToolchainCache::save() const
+{
+    if (_fileName.empty())
+	return;
+
+    std::ostringstream out;
+    out << "version " << toolchainVersion << '\n'
+        << "key " << _key << '\n'
+        << "command " << _command << '\n'
+        << "ccache " << (_hasCcache ? "yes" : "no") << '\n'
+        << "compiler " << _compiler << '\n';
+
+    (void) hbcxx::replaceFile(_fileName, out.str());
+}
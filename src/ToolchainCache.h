@@ -0,0 +1,65 @@
+/*
+ * ToolchainCache.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_TOOLCHAIN_CACHE_H_
+#define HBCXX_TOOLCHAIN_CACHE_H_
+
+#include <string>
+
+/*!
+ * Results of auto-detecting the compiler, stored in ~/.hbcxx/toolchain.
+ *
+ * Detecting the compiler requires probe compilations. The results are
+ * keyed on the location and stamp of every candidate program (ccache,
+ * g++ and clang++) so that checking whether they are still valid requires
+ * nothing more than a few calls to ::stat().
+ */
+class ToolchainCache {
+public:
+    ToolchainCache();
+    ~ToolchainCache();
+
+    /*!
+     * Load the previous results.
+     *
+     * \returns false if there are no results or the toolchain has changed
+     */
+    bool lookup();
+
+    /*!
+     * Detect the toolchain and save the results.
+     *
+     * Raises ToolsetError if no suitable compiler can be found.
+     */
+    void probe();
+
+    /*!
+     * The compiler command (possibly prefixed with ccache).
+     */
+    const std::string& getCommand() const;
+    bool hasCcache() const;
+    const std::string& getCompiler() const;
+
+private:
+    static std::string calculateKey();
+    static bool cxx11Check(const std::string& cxx);
+    void save() const;
+
+    std::string _fileName;
+    std::string _key;
+    std::string _command;
+    bool _hasCcache;
+    std::string _compiler;
+};
+
+#endif // HBCXX_TOOLCHAIN_CACHE_H_
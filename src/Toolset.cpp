@@ -13,20 +13,29 @@
 
 #include "Toolset.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <utility>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
+#include "filesystem.h"
+#include "hash.h"
+#include "string.h"
 #include "system.h"
+#include "trace.h"
 #include "CompilationUnit.h"
+#include "DependencyDatabase.h"
+#include "JobPool.h"
 #include "Options.h"
+#include "ToolchainCache.h"
 
-using std::begin;
-using std::end;
 namespace file = boost::filesystem;
 
 Toolset::Toolset()
@@ -34,7 +43,14 @@ Toolset::Toolset()
     , _hasCcache{false}
     , _flags{}
     , _lateFlags{}
+    , _compilerCommand{}
+    , _compileFlags{}
+    , _hasCompileFlags{false}
+    , _newHeaders{}
+    , _unityObjectFileName{}
 {
+	hbcxx::Span span{"detect toolset"};
+
 	auto cxx = std::getenv("CXX");
 	if (nullptr != cxx) {
             // setting the C compiler in the environment overrides the default
@@ -44,30 +60,12 @@ Toolset::Toolset()
 	    // load the default from the rc file
 	    _cxx = Options::cxx();
 	} else {
-	    if (0 == hbcxx::system("ccache --version >/dev/null 2>&1")) {
-		_cxx += "ccache ";
-		_hasCcache = true;
-	    } else {
-                std::cerr << PACKAGE_NAME << ": warning: cannot auto-detect "
-                                             "ccache (build will be slow)\n";
-            }
-
-	    if (cxx11Check("g++")) {
-		_cxx += "g++";
-	    } else if (cxx11Check("clang++")) {
-		_cxx += "clang++";
-	    } else {
-                std::cerr << PACKAGE_NAME
-                          << ": error: cannot auto-detect a C++ compiler\n";
-                throw ToolsetError{};
-	    }
-
-	    // cache the results
-	    auto home = std::getenv("HOME");
-            auto rcfname = file::path{home ? home : nullptr} / ".hbcxx"
-                          / "hbcxxrc";
-	    std::ofstream rcfile{rcfname.native(), std::ios_base::app};
-	    rcfile << "cxx=" << _cxx << '\n';
+	    // auto-detect the compiler (or reuse the results from last time)
+	    auto toolchain = ToolchainCache{};
+	    if (!toolchain.lookup())
+		toolchain.probe();
+	    _cxx = toolchain.getCommand();
+	    _hasCcache = toolchain.hasCcache();
         }
 
 	auto debugger = Options::debugger();
@@ -97,111 +95,640 @@ void Toolset::pushFlag(std::string flag, FlagPosition position)
 	    _cxx = "";
 
 	_cxx += flag.substr(sizeof("--hbcxx-cxx=")-1);
+	_compilerCommand.clear();
 
 	return;
     }
 
     switch (position) {
     case FlagEarly:
-	_flags.push_front(std::move(flag));
+	_flags.pushFront(std::move(flag));
+	_hasCompileFlags = false;
 	break;
     case FlagNormal:
-	_flags.push_back(std::move(flag));
+	_flags.pushBack(std::move(flag));
+	_hasCompileFlags = false;
 	break;
     case FlagLate:
-	_lateFlags.push_back(std::move(flag));
+	_lateFlags.pushBack(std::move(flag));
 	break;
     default:
 	assert(0);
     }
 }
 
-void Toolset::pushFlags(const std::list<std::string>& flags, FlagPosition position)
+void Toolset::pushFlags(const FlagSet& flags, FlagPosition position)
 {
     // If we are pushing the flags in the default position and the new flags
     // already appear in an identical order we can skip these flags. Note that
     // we do require all flags to be matched in order to avoid any problems
     // due to single pass linking.
-    if (position == FlagNormal
-        && std::search(begin(_flags), end(_flags), begin(flags), end(flags))
-           != end(_flags))
+    if (position == FlagNormal && _flags.contains(flags))
 	return;
 
     for (auto flag : flags)
 	pushFlag(flag, position);
 }
 
-void Toolset::compile(CompilationUnit& unit)
+/*!
+ * Check for flags that only influence the linker.
+ *
+ * These are omitted from compiler commands so that discovering a new library
+ * does not alter the command used to compile units we have already seen.
+ */
+static bool isLinkerFlag(const std::string& flag)
 {
-    if (unit.getIsHeader())
-        return;
+    return boost::starts_with(flag, "-l") || boost::starts_with(flag, "-L") ||
+           boost::starts_with(flag, "-Wl,");
+}
+
+/*!
+ * Check whether the compiler can be fed source code through a pipe.
+ *
+ * ccache cannot cache compilations from stdin so, if it is in use, we
+ * prefer to write processed files to disk.
+ */
+bool Toolset::usesCcache() const
+{
+    for (auto& program : hbcxx::shlex(_cxx))
+	if (file::path{program}.filename() == "ccache")
+	    return true;
 
-    auto command = _cxx + " -std=c++11 -c " + unit.getProcessedFileName()
-                   + " -o " + unit.getObjectFileName();
+    return false;
+}
 
-    for (const auto& flag : _flags)
-	command += std::string{" '"} + flag + "'";
+bool Toolset::canCompileFromPipe() const
+{
+    return !Options::saveTemps() && !usesCcache();
+}
+
+/*!
+ * Check whether ccache has been told that it can cache compilations that
+ * use precompiled headers.
+ */
+static bool canCcachePrecompiledHeaders()
+{
+    auto sloppiness = std::getenv("CCACHE_SLOPPINESS");
+    if (nullptr == sloppiness)
+	return false;
+
+    auto value = std::string{sloppiness};
+    return value.find("pch_defines") != std::string::npos &&
+           value.find("time_macros") != std::string::npos;
+}
+
+std::list<std::string> Toolset::getCompilerCommand() const
+{
+    if (!_compilerCommand.empty())
+	return _compilerCommand;
+
+    auto command = hbcxx::shlex(_cxx);
+    if (command.empty())
+	throw ToolsetError{};
+
+    // we do not use the shell so we must search the PATH ourselves
+    auto path = hbcxx::which(command.front());
+    if (!path.empty())
+	command.front() = path;
+
+    command.push_back("-std=c++11");
+    _compilerCommand = command;
+    return command;
+}
+
+std::list<std::string> Toolset::getUnitFlags(const CompilationUnit& unit) const
+{
+    if (!_hasCompileFlags) {
+	_compileFlags.clear();
+	auto skipNext = bool{false};
+	for (const auto& flag : _flags) {
+	    if (skipNext || isLinkerFlag(flag)) {
+		// the double token form ("-l", "foo") must skip both tokens
+		skipNext = !skipNext && (flag == "-l" || flag == "-L");
+		continue;
+	    }
+	    _compileFlags.push_back(flag);
+	}
+	_hasCompileFlags = true;
+    }
+
+    auto flags = _compileFlags;
     for (const auto& flag : unit.getPrivateFlags())
-	command += std::string{" '"} + flag + "'";
+	flags.push_back(flag);
     for (const auto& flag : _lateFlags)
-	command += std::string{" '"} + flag + "'";
+	flags.push_back(flag);
+    return flags;
+}
 
-    if (Options::verbose())
-	std::cerr << "hbcxx: running: " << command << std::endl;
-    auto res = hbcxx::system(command);
-    if (0 != res)
-	throw ToolsetError{};
+std::list<std::string> Toolset::getCompileCommand(CompilationUnit& unit,
+                                                  ProcessedSource& input) const
+{
+    auto command = getCompilerCommand();
+    command.push_back("-c");
+
+    input = ProcessedSource{};
+    if (unit.needsRewrite() && !unit.getHasLocalIncludes() &&
+        canCompileFromPipe()) {
+	// the compiler would search for quoted includes in the current
+	// directory (rather than next to the original file) so units that
+	// have any are compiled from the processed file instead
+	input = unit.getProcessedSource();
+	command.push_back("-x");
+	command.push_back("c++");
+	command.push_back("-");
+    } else if (unit.needsRewrite()) {
+	command.push_back(unit.writeProcessedFile());
+    } else {
+	command.push_back(unit.getProcessedFileName());
+    }
+
+    auto flags = getUnitFlags(unit);
+    command.splice(command.end(), flags);
+
+    // the object file is named after everything that affects its contents
+    // (apart from the header files) so that the name is the same each time
+    // the unit is compiled
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{"hbcxx-object-1"});
+    hash.update(file::current_path().string());
+    for (const auto& arg : command)
+	hash.update(arg);
+    (void) hash.updateFromFile(unit.getInputFileName());
+    unit.setObjectKey(hash.hex());
+
+    // the compiler writes to a private file which is renamed once it is
+    // complete (see link())
+    command.push_back("-o");
+    command.push_back(unit.getObjectOutputFileName());
+
+    // gather the headers used so later runs can tell whether the object
+    // file is still up to date
+    command.push_back("-MD");
+    command.push_back("-MF");
+    command.push_back(unit.getObjectOutputFileName() + ".d");
+
+    return command;
+}
+
+/*!
+ * Check whether the compiler is clang (which cannot read gcc's .gch files).
+ */
+bool Toolset::isClang() const
+{
+    for (auto& program : hbcxx::shlex(_cxx))
+	if (file::path{program}.filename().string().find("clang") !=
+	    std::string::npos)
+	    return true;
+
+    return false;
+}
+
+std::string Toolset::getPrecompiledHeader(const CompilationUnit& unit,
+                                          JobPool* jobs,
+                                          std::string& after) const
+{
+    after.clear();
+
+    auto& includes = unit.getLeadingIncludes();
+    if (includes.empty() || !Options::cache())
+	return std::string{};
+
+    // ccache would compile (rather than cache) every unit that uses a
+    // precompiled header
+    if (usesCcache() && !canCcachePrecompiledHeaders())
+	return std::string{};
+
+    auto store = hbcxx::storeDirectory();
+    if (store.empty())
+	return std::string{};
+
+    auto command = getCompilerCommand();
+    command.push_back("-x");
+    command.push_back("c++-header");
+    auto flags = getUnitFlags(unit);
+    command.splice(command.end(), flags);
+
+    // the header is named after everything that affects the precompiled
+    // header so it can be shared by any unit that matches
+    auto contents = std::string{};
+    for (const auto& header : includes)
+	contents += "#include <" + header + ">\n";
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{"hbcxx-pch-1"});
+    hash.update(file::current_path().string());
+    for (const auto& arg : command)
+	hash.update(arg);
+    hash.update(contents);
+
+    auto directory = store + "/pch";
+    auto header = directory + "/" + hash.hex() + ".h";
+    auto pch = header + (isClang() ? ".pch" : ".gch");
+
+    // a block is only precompiled the second time it is seen; this keeps
+    // the cost of precompiling away from programs that are only built once
+    boost::system::error_code ec;
+    if (_newHeaders.count(header))
+	return std::string{};
+    if (!file::exists(header, ec)) {
+	file::create_directories(directory, ec);
+	(void) hbcxx::replaceFile(header, contents);
+	_newHeaders.insert(header);
+	return std::string{};
+    }
+
+    if (DependencyDatabase::isUpToDate(pch))
+	return header;
+
+    // gcc silently falls back to the headers if a precompiled header is
+    // missing (but not if it is merely out of date) so units can wait for
+    // it to be built. clang would reject a precompiled header that had
+    // been replaced, by a concurrent build, with an out of date one.
+    auto usable = isClang() ? std::string{} : header;
+    if (nullptr == jobs) {
+	after = usable.empty() ? std::string{} : pch;
+	return usable;
+    }
+
+    // the out of date header must not be used if the rebuild fails
+    file::remove(pch, ec);
+
+    auto output = pch + hbcxx::unique();
+    command.push_back(header);
+    command.push_back("-o");
+    command.push_back(output);
+    command.push_back("-MD");
+    command.push_back("-MF");
+    command.push_back(output + ".d");
+
+    // the unit will still compile without the precompiled header (and
+    // will report any errors in the headers better than we can)
+    auto startTime = hbcxx::currentTime();
+    jobs->prepare(pch, command, {output, output + ".d"},
+                  [pch, output, startTime](bool ok) {
+	if (ok && 0 == std::rename(output.c_str(), pch.c_str()))
+	    DependencyDatabase::record(pch, output + ".d", startTime);
+	else
+	    (void) std::remove(output.c_str());
+    });
+
+    if (!usable.empty())
+	after = pch;
+    return usable;
+}
+
+void Toolset::addPrecompiledHeader(const CompilationUnit& unit,
+                                   std::list<std::string>& command,
+                                   JobPool* jobs, std::string& after) const
+{
+    auto header = getPrecompiledHeader(unit, jobs, after);
+    if (header.empty())
+	return;
+
+    // the header must be included before anything else (and the compiler
+    // falls back to the textual header if the precompiled one is rejected)
+    auto pos = command.begin();
+    std::advance(pos, getCompilerCommand().size() + 1);
+    command.insert(pos, {"-include", header});
+}
+
+/*!
+ * Emulate a unit's private flags within a unity build.
+ *
+ * Macros are defined before the unit is included (and undefined after it).
+ * Any other private flag (such as an include directory) would apply to the
+ * whole unity build so units that use them must be compiled separately.
+ *
+ * \returns false if the flags cannot be emulated
+ */
+static bool getUnityFlags(const CompilationUnit& unit, std::string& defines,
+                          std::string& undefines)
+{
+    auto& flags = unit.getPrivateFlags();
+    for (auto it = flags.begin(); it != flags.end(); ++it) {
+	if (!boost::starts_with(*it, "-D"))
+	    return false;
+
+	// handle both the single and double token forms
+	auto value = it->substr(2);
+	if (value.empty()) {
+	    if (++it == flags.end())
+		return false;
+	    value = *it;
+	}
+
+	auto equals = value.find('=');
+	auto name = value.substr(0, equals);
+	defines += "#define " + name + ' '
+	           + (equals == std::string::npos ? std::string{"1"}
+	                                           : value.substr(equals + 1))
+	           + '\n';
+	undefines += "#undef " + name.substr(0, name.find('(')) + '\n';
+    }
+
+    return true;
+}
+
+void Toolset::compileUnity(std::list<CompilationUnit>& units, JobPool& jobs)
+{
+    struct Member {
+	CompilationUnit* unit;
+	std::string path;
+	std::string defines;
+	std::string undefines;
+    };
+
+    auto members = std::vector<Member>{};
+    for (auto& unit : units) {
+	if (unit.getIsHeader())
+	    continue;
+
+	// rewritten units are included from the build directory (and their
+	// #line marker ensures diagnostics still name the original file)
+	auto member = Member{&unit, std::string{}, std::string{},
+	                     std::string{}};
+	member.path = unit.needsRewrite()
+	                  ? unit.writeProcessedFile()
+	                  : file::absolute(unit.getInputFileName()).string();
+	if (getUnityFlags(unit, member.defines, member.undefines))
+	    members.push_back(std::move(member));
+	else if (Options::verbose())
+	    std::cerr << "hbcxx: unity build excludes (private flags): "
+	              << unit.getInputFileName() << '\n';
+    }
+    if (members.size() < 2)
+	return;
+
+    auto buildDirectory = file::path{hbcxx::storeDirectory()} / "build";
+    boost::system::error_code ec;
+    file::create_directories(buildDirectory, ec);
+
+    // units that had to be compiled separately are remembered (for as long
+    // as the sources and flags remain the same)
+    auto hash = hbcxx::Hash{};
+    hash.update(std::string{"hbcxx-unity-2"});
+    for (const auto& flag : _flags)
+	hash.update(flag);
+    for (auto& member : members) {
+	hash.update(member.path);
+	hash.update(member.defines);
+	(void) hash.updateFromFile(member.path);
+    }
+    auto excludedFileName =
+	(buildDirectory / ("unity-" + hash.hex() + ".excluded")).string();
+
+    auto excluded = std::set<std::string>{};
+    std::ifstream excludedFile{excludedFileName};
+    for (auto name = std::string{}; std::getline(excludedFile, name); )
+	excluded.insert(name);
+    auto newExclusions = false;
+
+    // write the source that includes the first count members
+    auto writeSource = [&](size_t count) {
+	auto source = std::string{"// unity build generated by hbcxx\n"};
+	for (size_t i = 0; i < count; i++) {
+	    source += members[i].defines;
+	    source += "#include \"" + members[i].path + "\"\n";
+	    source += members[i].undefines;
+	}
+
+	auto sourceHash = hbcxx::Hash{};
+	sourceHash.update(source);
+	auto sourceFileName =
+	    (buildDirectory / ("unity-" + sourceHash.hex() + ".cpp")).string();
+	auto st = hbcxx::FileStamp{};
+	if (!hbcxx::stamp(sourceFileName, st) || st.size != source.size()) {
+	    if (!hbcxx::replaceFile(sourceFileName, source))
+		throw ToolsetError{};
+	} else {
+	    hbcxx::markAccessed(sourceFileName);
+	}
+	return sourceFileName;
+    };
+
+    for (;;) {
+	members.erase(std::remove_if(members.begin(), members.end(),
+	                             [&](const Member& member) {
+	    return excluded.count(member.unit->getInputFileName());
+	}), members.end());
+	if (members.size() < 2)
+	    break;
+
+	auto sourceFileName = writeSource(members.size());
+	CompilationUnit unity{sourceFileName};
+	auto input = ProcessedSource{};
+	auto command = getCompileCommand(unity, input);
+	auto output = unity.getObjectOutputFileName();
+
+	auto ok = DependencyDatabase::isUpToDate(unity.getObjectFileName());
+	if (!ok) {
+	    unity.setCompileTime(hbcxx::currentTime());
+	    jobs.prepare(unity.getObjectFileName(), command,
+	                 {output, output + ".d"},
+	                 [&ok](bool result) { ok = result; });
+	    (void) jobs.wait();
+	}
+
+	if (ok) {
+	    unity.setObjectPending(true);
+	    if (unity.publishObjectFile())
+		DependencyDatabase::record(unity.getObjectFileName(),
+		                           output + ".d", unity.getCompileTime());
+
+	    if (Options::verbose())
+		std::cerr << "hbcxx: unity build of " << members.size()
+		          << " units: " << sourceFileName << '\n';
+	    for (auto& member : members)
+		member.unit->setIsMerged(true);
+	    _unityObjectFileName = unity.getObjectFileName();
+	    break;
+	}
+
+	// find the first member that cannot be added to the members before
+	// it by checking the syntax of every shorter prefix in parallel (a
+	// member that fails on its own is found the same way)
+	auto culprit = members.size() - 1;
+	for (size_t count = 1; count < members.size(); count++) {
+	    CompilationUnit prefix{writeSource(count)};
+	    auto check = getCompileCommand(prefix, input);
+	    check.push_back("-fsyntax-only");
+	    auto checkOutput = prefix.getObjectOutputFileName();
+	    jobs.prepare(prefix.getInputFileName(), check,
+	                 {checkOutput, checkOutput + ".d"},
+	                 [&culprit, count, checkOutput](bool result) {
+		if (!result && count - 1 < culprit)
+		    culprit = count - 1;
+		(void) std::remove(checkOutput.c_str());
+		(void) std::remove((checkOutput + ".d").c_str());
+	    });
+	}
+	(void) jobs.wait();
+
+	auto name = members[culprit].unit->getInputFileName();
+	if (Options::verbose())
+	    std::cerr << "hbcxx: unity build excludes: " << name << '\n';
+	excluded.insert(name);
+	newExclusions = true;
+    }
+
+    if (newExclusions) {
+	auto contents = std::string{};
+	for (auto& name : excluded)
+	    contents += name + '\n';
+	(void) hbcxx::replaceFile(excludedFileName, contents);
+    }
+}
+
+void Toolset::speculate(CompilationUnit& unit, JobPool& jobs)
+{
+    // unity builds cannot start until every unit has been found
+    if (unit.getIsHeader() || Options::unity())
+        return;
+
+    auto input = ProcessedSource{};
+    auto command = getCompileCommand(unit, input);
+    if (DependencyDatabase::isUpToDate(unit.getObjectFileName()))
+	return;
+
+    // a unit that has to wait for its precompiled header is not speculated
+    auto after = std::string{};
+    addPrecompiledHeader(unit, command, nullptr, after);
+    if (!after.empty())
+	return;
+
+    auto outputs = std::list<std::string>{unit.getObjectOutputFileName()};
+    outputs.push_back(unit.getObjectOutputFileName() + ".d");
+    unit.setCompileTime(hbcxx::currentTime());
+    (void) jobs.speculate(command, outputs, input);
+}
+
+void Toolset::compile(std::list<CompilationUnit>& units, JobPool& jobs)
+{
+    struct Command {
+	std::list<std::string> command;
+	ProcessedSource input;
+	std::string after;
+    };
+    auto commands = std::list<Command>{};
+
+    if (Options::unity())
+	compileUnity(units, jobs);
+
+    for (auto& unit : units) {
+	if (unit.getIsHeader() || unit.getIsMerged())
+	    continue;
+
+	auto input = ProcessedSource{};
+	auto command = getCompileCommand(unit, input);
+
+	// objects built by a previous run are reused if none of their
+	// headers have changed
+	auto upToDate = DependencyDatabase::isUpToDate(unit.getObjectFileName());
+	unit.setObjectPending(!upToDate);
+	if (upToDate)
+	    continue;
+
+	// an adopted job keeps the time at which it was speculated
+	auto after = std::string{};
+	addPrecompiledHeader(unit, command, &jobs, after);
+	if (!jobs.adopt(command)) {
+	    unit.setCompileTime(hbcxx::currentTime());
+	    commands.push_back(Command{std::move(command), std::move(input),
+	                               std::move(after)});
+	}
+    }
+
+    // stale speculative jobs might be writing to the same object files as
+    // their replacements
+    jobs.discardSpeculative();
+
+    for (auto& command : commands) {
+	hbcxx::poll_signals();
+	if (!jobs.submit(command.command, command.input, command.after))
+	    throw ToolsetError{};
+    }
 }
 
 void Toolset::link(std::list<CompilationUnit>& units)
 {
-    auto command = _cxx + " -std=c++11 -o "
-                   + units.front().getExecutableFileName();
+    // publish the objects before linking them so that they can be shared
+    // with concurrent (and later) invocations
     for (auto& unit : units) {
-        if (unit.getIsHeader())
-            continue;
-        command += ' ';
-        command += unit.getObjectFileName();
+	if (unit.getIsHeader() || unit.getIsMerged())
+	    continue;
+
+	auto depFile = unit.getObjectOutputFileName() + ".d";
+	if (unit.publishObjectFile())
+	    DependencyDatabase::record(unit.getObjectFileName(), depFile,
+	                               unit.getCompileTime());
     }
 
+    auto command = getCompilerCommand();
+    command.push_back("-o");
+    command.push_back(units.front().getExecutableFileName());
+    command.splice(command.end(), getObjectFiles(units));
+
     for (const auto& flag : _flags)
-	command += std::string{" '"} + flag + "'";
+	command.push_back(flag);
 
     if (Options::verbose())
-	std::cerr << "hbcxx: running: " << command << std::endl;
-    auto res = hbcxx::system(command);
+	std::cerr << "hbcxx: running: " << hbcxx::shjoin(command) << std::endl;
+    auto res = hbcxx::system(command.front(), command);
+    hbcxx::poll_signals();
     if (0 != res)
 	throw ToolsetError{};
 }
 
-bool Toolset::cxx11Check(std::string cxx)
+std::list<std::string> Toolset::getObjectFiles(
+    const std::list<CompilationUnit>& units) const
 {
-    auto home = std::getenv("HOME");
-    if (nullptr == home)
-	throw ToolsetError{};
+    auto objects = std::list<std::string>{};
+    if (!_unityObjectFileName.empty())
+	objects.push_back(_unityObjectFileName);
+    for (auto& unit : units) {
+        if (unit.getIsHeader() || unit.getIsMerged())
+            continue;
+        objects.push_back(unit.getObjectFileName());
+    }
 
-    auto stem = file::path{home};
-    stem /= ".hbcxx";
-    auto cxxfile = stem / "cxx11check.cpp";
-    auto objfile = stem / "cxx11check.o";
-
-    (void) file::create_directories(cxxfile.parent_path());
-
-    // this small C++ program exercises three critical C++11 features
-    // (auto types, smart pointers and lambdas) whilst using sufficiently
-    // few templates to allow fast syntax checking.
-    std::ofstream f{cxxfile.native()};
-    f << "#include <memory>\n"
-      << "int main()\n"
-      << "{\n"
-      << "    auto p = std::unique_ptr<int>{new int{0}};\n"
-      << "    auto deref = [&](){ return *p; };\n"
-      << "    return deref();\n"
-      << "}\n";
-    f.close();
-
-    auto command = cxx +
-                   " -std=c++11 -c " + cxxfile.native() +
-                              " -o " + objfile.native(); // + " >/dev/null 2>&1";
-    return (0 == hbcxx::system(command));
+    return objects;
+}
+
+std::string Toolset::getIdentity() const
+{
+    auto identity = _cxx + " -std=c++11";
+
+    for (auto& path : getPrograms()) {
+	auto st = hbcxx::FileStamp{};
+	if (!hbcxx::stamp(path, st))
+	    continue;
+
+	identity += '\n';
+	identity += path + ' ' + std::to_string(st.size) + ' '
+	            + std::to_string(st.mtime_ns);
+    }
+
+    return identity;
+}
+
+std::list<std::string> Toolset::getPrograms() const
+{
+    auto programs = std::list<std::string>{};
+
+    for (auto& program : hbcxx::shlex(_cxx)) {
+	auto path = hbcxx::which(program);
+	if (!path.empty())
+	    programs.push_back(std::move(path));
+    }
+
+    return programs;
+}
+
+const FlagSet& Toolset::getFlags() const
+{
+    return _flags;
+}
+
+const FlagSet& Toolset::getLateFlags() const
+{
+    return _lateFlags;
 }
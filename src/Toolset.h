@@ -15,11 +15,16 @@
 #define HBCXX_TOOLSET_H_
 
 class CompilationUnit;
+class JobPool;
 
 #include <exception>
 #include <list>
+#include <set>
 #include <string>
 
+#include "FlagSet.h"
+#include "ProcessedSource.h"
+
 class Toolset {
 public:
     enum FlagPosition {
@@ -40,19 +45,106 @@ public:
      * two forms, single token ("-DTHIS=that") and double token ("-D",
      * "THIS=that").
      */
-    void pushFlags(const std::list<std::string>& flags,
-                   FlagPosition position = FlagNormal);
+    void pushFlags(const FlagSet& flags, FlagPosition position = FlagNormal);
+
+    /*!
+     * Speculatively compile a unit using the flags gathered so far.
+     *
+     * This allows compilation to overlap with pre-pre-processing of the
+     * remaining units. If the flags change before compile() is called then
+     * the speculative compilation is discarded.
+     */
+    void speculate(CompilationUnit& unit, JobPool& jobs);
 
-    void compile(CompilationUnit& unit);
+    /*!
+     * Compile all the units using jobs from the supplied pool.
+     *
+     * Speculative compilations whose command has not changed are adopted
+     * rather than being run again. The compilations run asynchronously;
+     * the caller must use JobPool::wait() to discover whether they were
+     * successful.
+     */
+    void compile(std::list<CompilationUnit>& units, JobPool& jobs);
     void link(std::list<CompilationUnit>& units);
 
+    /*!
+     * Get the object files that link() combines into the executable.
+     */
+    std::list<std::string> getObjectFiles(
+        const std::list<CompilationUnit>& units) const;
+
+    /*!
+     * Describe the compiler in enough detail to tell when it has changed.
+     *
+     * The identity contains the compiler command together with the
+     * location, size and modification time of each program it runs.
+     */
+    std::string getIdentity() const;
+
+    /*!
+     * Get the path of each program run by the compiler command.
+     */
+    std::list<std::string> getPrograms() const;
+
+    const FlagSet& getFlags() const;
+    const FlagSet& getLateFlags() const;
+
 private:
-    bool cxx11Check(std::string cxx);
+    bool usesCcache() const;
+    bool canCompileFromPipe() const;
+    std::list<std::string> getCompilerCommand() const;
+    std::list<std::string> getUnitFlags(const CompilationUnit& unit) const;
+    std::list<std::string> getCompileCommand(CompilationUnit& unit,
+                                             ProcessedSource& input) const;
+    bool isClang() const;
+
+    /*!
+     * Get a precompiled header for the unit's leading system includes.
+     *
+     * If the precompiled header (in ~/.hbcxx/pch) is missing or out of date
+     * it is built using a prerequisite job from the pool. Without a pool
+     * nothing is built.
+     *
+     * clang refuses to compile if a precompiled header is out of date so,
+     * for clang, only precompiled headers that were up to date before the
+     * unit's command was formed are used.
+     *
+     * \param after set to the name of the prerequisite the unit must wait
+     *              for (or cleared if the unit need not wait)
+     * \returns the header to -include or an empty string if there is no
+     *          usable precompiled header
+     */
+    std::string getPrecompiledHeader(const CompilationUnit& unit,
+                                     JobPool* jobs, std::string& after) const;
+    void addPrecompiledHeader(const CompilationUnit& unit,
+                              std::list<std::string>& command, JobPool* jobs,
+                              std::string& after) const;
+
+    /*!
+     * Compile as many units as possible as a single translation unit.
+     *
+     * The merged units are marked (see CompilationUnit::setIsMerged()) so
+     * compile() can handle the others as normal. The unity build runs in
+     * the job pool but this waits for it (and for anything needed to
+     * decide which units to leave out) to complete.
+     */
+    void compileUnity(std::list<CompilationUnit>& units, JobPool& jobs);
 
     std::string _cxx;
     bool _hasCcache;
-    std::list<std::string> _flags;
-    std::list<std::string> _lateFlags;
+    FlagSet _flags;
+    FlagSet _lateFlags;
+
+    // the parts of the compile command shared by every unit are built once
+    // (and rebuilt only when the flags or the compiler change)
+    mutable std::list<std::string> _compilerCommand;
+    mutable std::list<std::string> _compileFlags;
+    mutable bool _hasCompileFlags;
+
+    // include blocks seen for the first time by this run
+    mutable std::set<std::string> _newHeaders;
+
+    std::string _unityObjectFileName;
 };
 
 class ToolsetError : public std::exception {
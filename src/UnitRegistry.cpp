@@ -0,0 +1,78 @@
+/*
+ * UnitRegistry.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "UnitRegistry.h"
+
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "filesystem.h"
+
+namespace file = boost::filesystem;
+
+UnitRegistry::UnitRegistry(const std::string& primaryFile)
+    : _units{}
+    , _index{}
+{
+    (void) add(CompilationUnit{primaryFile});
+}
+
+UnitRegistry::~UnitRegistry()
+{
+}
+
+CompilationUnit* UnitRegistry::add(CompilationUnit&& unit)
+{
+    auto identity = getIdentity(unit.getInputFileName());
+    auto i = _index.find(identity);
+    if (i != _index.end())
+	return nullptr;
+
+    _units.push_back(std::move(unit));
+    auto added = &_units.back();
+    _index.emplace(std::move(identity), added);
+    return added;
+}
+
+CompilationUnit& UnitRegistry::getPrimary()
+{
+    return _units.front();
+}
+
+std::list<CompilationUnit>& UnitRegistry::getUnits()
+{
+    return _units;
+}
+
+std::string UnitRegistry::getIdentity(const std::string& fname)
+{
+    auto st = hbcxx::FileStamp{};
+    if (hbcxx::stamp(fname, st))
+	return std::to_string(st.dev) + ':' + std::to_string(st.ino);
+
+    // remove any "." and ".." components (without following symlinks,
+    // which is the best we can do for a file that does not exist)
+    auto normalized = file::path{};
+    for (auto& part : file::absolute(fname)) {
+	if (part == ".")
+	    continue;
+	else if (part == "..") {
+	    if (normalized.has_relative_path())
+		normalized.remove_filename();
+	} else
+	    normalized /= part;
+    }
+
+    return normalized.string();
+}
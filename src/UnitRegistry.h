@@ -0,0 +1,60 @@
+/*
+ * UnitRegistry.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_UNIT_REGISTRY_H_
+#define HBCXX_UNIT_REGISTRY_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "CompilationUnit.h"
+
+/*!
+ * The set of compilation units that make up a program.
+ *
+ * Units are indexed by the identity of the file they were created from
+ * (device and inode, or the normalized absolute path if the file does not
+ * exist) so that the same file reached by two different paths is only
+ * compiled once.
+ *
+ * Units are kept in the order they were added (the first being the
+ * primary unit) and are never moved once added, so references to them
+ * remain valid and the list can be iterated whilst units are being added.
+ */
+class UnitRegistry {
+public:
+    explicit UnitRegistry(const std::string& primaryFile);
+    ~UnitRegistry();
+
+    /*!
+     * Add a unit unless one for the same file has already been added.
+     *
+     * \returns the added unit or nullptr if the unit was a duplicate
+     */
+    CompilationUnit* add(CompilationUnit&& unit);
+
+    CompilationUnit& getPrimary();
+    std::list<CompilationUnit>& getUnits();
+
+private:
+    UnitRegistry(const UnitRegistry&);
+    UnitRegistry& operator=(const UnitRegistry&);
+
+    static std::string getIdentity(const std::string& fname);
+
+    std::list<CompilationUnit> _units;
+    std::unordered_map<std::string, CompilationUnit*> _index;
+};
+
+#endif // HBCXX_UNIT_REGISTRY_H_
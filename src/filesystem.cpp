@@ -13,10 +13,175 @@
 
 #include "filesystem.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 
+#include "system.h"
+
 bool hbcxx::touch(const std::string& fname)
 {
     std::ofstream f{fname, std::ios::app};
     return f.is_open();
 }
+
+bool hbcxx::FileStamp::operator==(const FileStamp& that) const
+{
+    return dev == that.dev && ino == that.ino && size == that.size &&
+           mtime_ns == that.mtime_ns;
+}
+
+bool hbcxx::stamp(const std::string& fname, FileStamp& st)
+{
+    struct stat sb;
+    if (0 != ::stat(fname.c_str(), &sb))
+	return false;
+
+    st.dev = sb.st_dev;
+    st.ino = sb.st_ino;
+    st.size = sb.st_size;
+    st.mtime_ns = std::uint64_t(sb.st_mtim.tv_sec) * 1000000000 +
+                  sb.st_mtim.tv_nsec;
+    return true;
+}
+
+std::uint64_t hbcxx::currentTime()
+{
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::uint64_t(now);
+}
+
+hbcxx::StampedFile hbcxx::stampFile(const std::string& fname)
+{
+    auto now = currentTime();
+
+    auto stamped = StampedFile{fname, false, false, FileStamp{}};
+    stamped.exists = stamp(fname, stamped.st);
+    stamped.isRecent = stamped.exists &&
+                       stamped.st.mtime_ns > now - UINT64_C(2000000000);
+    return stamped;
+}
+
+void hbcxx::markAccessed(const std::string& fname)
+{
+    struct timespec times[2] = { { 0, UTIME_NOW }, { 0, UTIME_OMIT } };
+    (void) ::utimensat(AT_FDCWD, fname.c_str(), times, 0);
+}
+
+bool hbcxx::replaceFile(const std::string& fname, const std::string& contents)
+{
+    auto tmpname = fname + hbcxx::unique();
+
+    std::ofstream f{tmpname, std::ios::binary | std::ios::trunc};
+    f << contents;
+    f.close();
+
+    if (f.fail() || 0 != std::rename(tmpname.c_str(), fname.c_str())) {
+	(void) std::remove(tmpname.c_str());
+	return false;
+    }
+
+    return true;
+}
+
+std::string hbcxx::which(const std::string& name)
+{
+    if (name.find('/') != std::string::npos)
+	return (0 == ::access(name.c_str(), X_OK)) ? name : std::string{};
+
+    auto path = std::getenv("PATH");
+    if (nullptr == path)
+	return std::string{};
+
+    auto dirs = std::string{path};
+    auto begin = std::string::size_type{0};
+    while (begin <= dirs.size()) {
+	auto end = dirs.find(':', begin);
+	if (end == std::string::npos)
+	    end = dirs.size();
+
+	// an empty element of PATH means the current directory
+	auto dir = dirs.substr(begin, end - begin);
+	auto candidate = (dir.empty() ? std::string{"."} : dir) + '/' + name;
+	if (0 == ::access(candidate.c_str(), X_OK))
+	    return candidate;
+
+	begin = end + 1;
+    }
+
+    return std::string{};
+}
+
+std::string hbcxx::storeDirectory()
+{
+    auto home = std::getenv("HOME");
+    if (nullptr == home)
+	return std::string{};
+
+    return std::string{home} + "/.hbcxx";
+}
+
+hbcxx::MappedFile::MappedFile(const std::string& fname)
+    : _isOpen{false}
+    , _isMapped{false}
+    , _data{""}
+    , _size{0}
+    , _fallback{}
+{
+    auto fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+	return;
+
+    struct stat sb;
+    if (0 == fstat(fd, &sb) && S_ISREG(sb.st_mode)) {
+	_isOpen = true;
+	if (0 == sb.st_size) {
+	    ::close(fd);
+	    return;
+	}
+
+	auto map = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED != map) {
+	    ::close(fd);
+	    _isMapped = true;
+	    _data = static_cast<const char*>(map);
+	    _size = sb.st_size;
+	    return;
+	}
+    }
+
+    // mmap() is not supported for this file, fall back to read()
+    char buf[16384];
+    ssize_t len;
+    while (0 != (len = ::read(fd, buf, sizeof(buf)))) {
+	if (len < 0) {
+	    if (EINTR == errno)
+		continue;
+	    _fallback.clear();
+	    ::close(fd);
+	    _isOpen = false;
+	    return;
+	}
+	_fallback.append(buf, len);
+    }
+    ::close(fd);
+
+    _isOpen = true;
+    _data = _fallback.data();
+    _size = _fallback.size();
+}
+
+hbcxx::MappedFile::~MappedFile()
+{
+    if (_isMapped)
+	(void) munmap(const_cast<char*>(_data), _size);
+}
@@ -14,12 +14,125 @@
 #ifndef HBCXX_FILESYSTEM_H_
 #define HBCXX_FILESYSTEM_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace hbcxx {
 
 bool touch(const std::string& fname);
 
+/*!
+ * The identity of a file as reported by ::stat().
+ *
+ * Two stamps compare equal only if they describe the same inode with the
+ * same size and modification time.
+ */
+struct FileStamp {
+    std::uint64_t dev;
+    std::uint64_t ino;
+    std::uint64_t size;
+    std::uint64_t mtime_ns;
+
+    bool operator==(const FileStamp& that) const;
+    bool operator!=(const FileStamp& that) const { return !(*this == that); }
+};
+
+/*!
+ * Gather the FileStamp for the named file.
+ *
+ * \returns false if the file does not exist (or cannot be examined)
+ */
+bool stamp(const std::string& fname, FileStamp& st);
+
+/*!
+ * A file (or the absence of one) as it was when it was examined.
+ */
+struct StampedFile {
+    std::string fname;
+    bool exists;
+    bool isRecent; //!< modified too recently for the stamp to be trusted
+    FileStamp st;
+};
+
+/*!
+ * Get the current time in the same units as FileStamp::mtime_ns.
+ */
+std::uint64_t currentTime();
+
+/*!
+ * Stamp a file just before it is examined.
+ *
+ * Files modified within the last couple of seconds might be modified again
+ * (within the timestamp granularity) without their stamp changing so these
+ * are flagged as recent.
+ */
+StampedFile stampFile(const std::string& fname);
+
+/*!
+ * Record that a file has just been used.
+ *
+ * The access time is updated explicitly (because filesystems are often
+ * mounted with relatime or noatime) and the modification time is left
+ * alone. The garbage collector uses the access time to decide which
+ * files were least recently used.
+ */
+void markAccessed(const std::string& fname);
+
+/*!
+ * Atomically replace the contents of a file.
+ *
+ * The new contents are written to a temporary file in the same directory
+ * which is then renamed over the original. Readers therefore observe either
+ * the old or the new contents but never a partially written file.
+ */
+bool replaceFile(const std::string& fname, const std::string& contents);
+
+/*!
+ * Search the PATH for an executable.
+ *
+ * Names that contain a slash are not searched for but are still checked
+ * for existence.
+ *
+ * \returns the path to the executable or an empty string if not found
+ */
+std::string which(const std::string& name);
+
+/*!
+ * Get the path to the per-user hbcxx directory (usually ~/.hbcxx).
+ *
+ * \returns the path or an empty string if $HOME is not set
+ */
+std::string storeDirectory();
+
+/*!
+ * Read-only view of the contents of a file.
+ *
+ * The file is mapped into memory when possible so that even very large
+ * files can be examined without copying them. Files that cannot be mapped
+ * (pipes, some special files) are read into memory instead.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& fname);
+    ~MappedFile();
+
+    bool isOpen() const { return _isOpen; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+    std::size_t size() const { return _size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    bool _isOpen;
+    bool _isMapped;
+    const char* _data;
+    std::size_t _size;
+    std::string _fallback;
+};
+
 }; // namespace hbcxx
 
 #endif // HBCXX_FILESYSTEM_H_
@@ -0,0 +1,155 @@
+/*
+ * hash.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "filesystem.h"
+
+// FIPS 180-4, section 4.2.2
+static const std::uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static std::uint32_t rotr(std::uint32_t x, unsigned n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+hbcxx::Hash::Hash()
+    : _state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}
+    , _buffer{}
+    , _length{0}
+{
+}
+
+void hbcxx::Hash::compress(const unsigned char* block)
+{
+    std::uint32_t w[64];
+    for (auto i=0; i<16; i++)
+	w[i] = std::uint32_t(block[4*i]) << 24 |
+	       std::uint32_t(block[4*i + 1]) << 16 |
+	       std::uint32_t(block[4*i + 2]) << 8 |
+	       std::uint32_t(block[4*i + 3]);
+    for (auto i=16; i<64; i++) {
+	auto s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+	auto s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+	w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    auto a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+    auto e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+    for (auto i=0; i<64; i++) {
+	auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25))
+	          + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+	auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22))
+	          + ((a & b) ^ (a & c) ^ (b & c));
+	h = g;
+	g = f;
+	f = e;
+	e = d + t1;
+	d = c;
+	c = b;
+	b = a;
+	a = t1 + t2;
+    }
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+    _state[5] += f;
+    _state[6] += g;
+    _state[7] += h;
+}
+
+hbcxx::Hash& hbcxx::Hash::update(const void* data, std::size_t len)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    auto used = std::size_t(_length % 64);
+    _length += len;
+
+    // top up a partially filled block first
+    if (used) {
+	auto n = std::min(len, 64 - used);
+	std::memcpy(_buffer + used, p, n);
+	p += n;
+	len -= n;
+	if (used + n < 64)
+	    return *this;
+	compress(_buffer);
+    }
+
+    for (; len >= 64; p += 64, len -= 64)
+	compress(p);
+
+    std::memcpy(_buffer, p, len);
+    return *this;
+}
+
+hbcxx::Hash& hbcxx::Hash::update(const std::string& s)
+{
+    auto len = static_cast<std::uint64_t>(s.size());
+    update(&len, sizeof(len));
+    return update(s.data(), s.size());
+}
+
+bool hbcxx::Hash::updateFromFile(const std::string& fname)
+{
+    MappedFile in{fname};
+    if (!in.isOpen())
+	return false;
+
+    update(in.begin(), in.size());
+    return true;
+}
+
+std::string hbcxx::Hash::hex() const
+{
+    // pad a copy so that we can carry on updating the original
+    auto final = *this;
+    auto bits = _length * 8;
+    unsigned char padding[72] = { 0x80 };
+    auto used = std::size_t(_length % 64);
+    auto padLength = (used < 56 ? 56 : 120) - used;
+    for (auto i=0; i<8; i++)
+	padding[padLength + i] = static_cast<unsigned char>(bits >> (56 - 8*i));
+    final.update(padding, padLength + 8);
+
+    static const char digits[] = "0123456789abcdef";
+    auto s = std::string(64, '0');
+    for (auto i=0; i<8; i++)
+	for (auto j=0; j<8; j++)
+	    s[8*i + j] = digits[(final._state[i] >> (28 - 4*j)) & 0xf];
+
+    return s;
+}
@@ -0,0 +1,68 @@
+/*
+ * hash.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_HASH_H_
+#define HBCXX_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace hbcxx {
+
+/*!
+ * Incremental SHA-256 hash.
+ *
+ * This is used to derive names for the things hbcxx stores on behalf of the
+ * user. Executables are looked up using nothing but these names so the hash
+ * must be collision resistant; a clash would run the wrong program.
+ */
+class Hash {
+public:
+    Hash();
+
+    Hash& update(const void* data, std::size_t len);
+
+    /*!
+     * Add a string to the hash.
+     *
+     * The length is hashed along with the characters so that adjacent
+     * strings cannot run together ("ab" + "c" differs from "a" + "bc").
+     */
+    Hash& update(const std::string& s);
+
+    /*!
+     * Add the contents of a file to the hash.
+     *
+     * \returns false if the file could not be read
+     */
+    bool updateFromFile(const std::string& fname);
+
+    /*!
+     * Get the digest as 64 hex digits.
+     *
+     * The hash can continue to be updated afterwards.
+     */
+    std::string hex() const;
+
+private:
+    void compress(const unsigned char* block);
+
+    std::uint32_t _state[8];
+    unsigned char _buffer[64];
+    std::uint64_t _length; //!< bytes hashed so far
+};
+
+} // namespace hbcxx
+
+#endif // HBCXX_HASH_H_
@@ -14,7 +14,6 @@
 #include <signal.h>
 
 #include <cstdlib>
-#include <algorithm>
 #include <exception>
 #include <iostream>
 #include <list>
@@ -24,16 +23,26 @@
 
 #include <boost/filesystem.hpp>
 
+#include "filesystem.h"
 #include "string.h"
 #include "system.h"
+#include "trace.h"
 #include "util.h"
+#include "BuildLock.h"
 #include "CompilationUnit.h"
+#include "DirectoryCache.h"
+#include "ExecutableCache.h"
+#include "JobPool.h"
 #include "Launcher.h"
+#include "Manifest.h"
 #include "Options.h"
 #include "PrePreProcessor.h"
+#include "StoreManager.h"
 #include "Toolset.h"
+#include "UnitRegistry.h"
 
 using hbcxx::ScopeExit;
+using hbcxx::make_unique;
 namespace file = boost::filesystem;
 
 /*!
@@ -72,10 +81,12 @@ class ArgumentError : public std::exception {
  * Determine which program to build.
  *
  * Pops arguments from args until we can determine what program to build. At
- * this point args has had all toolset options removed and contains only those
- * arguments that must be passed to the program once we have built it.
+ * this point args has had all toolset options removed (and moved to flags)
+ * and contains only those arguments that must be passed to the program once
+ * we have built it.
  */
-static std::string handleArguments(std::list<std::string>& args, Toolset& toolset)
+static std::string handleArguments(std::list<std::string>& args,
+                                   std::list<std::string>& flags)
 {
     auto showHelp = bool{false};
 
@@ -87,12 +98,13 @@ static std::string handleArguments(std::list<std::string>& args, Toolset& toolse
 	if (arg == "--help" || arg == "-h")
 	    showHelp = true;
 
-	// if the file exists we will try to execute it
+	// if the file exists we will try to execute it (a plain stat() is
+	// cheaper than listing the script's directory on a warm launch)
 	if (file::exists(arg))
 	    return arg;
 
 	// otherwise we pass on the flag to the toolchain
-	toolset.pushFlag(arg);
+	flags.push_back(arg);
     }
 
     if (showHelp)
@@ -101,16 +113,128 @@ static std::string handleArguments(std::list<std::string>& args, Toolset& toolse
     throw ArgumentError{};
 }
 
-static int run(std::list<std::string>& args)
+/*!
+ * Use the manifest to find a previously built executable.
+ *
+ * \returns true if the executable is in the cache (in which case the
+ *          executable file name of primaryUnit is updated)
+ */
+static bool lookupFromManifest(const Manifest& manifest,
+                               CompilationUnit& primaryUnit)
 {
-    auto ppp = PrePreProcessor{};
-    auto toolset = Toolset{};
+    hbcxx::Span span{"check manifest"};
+    auto key = manifest.check();
+    if (key.empty())
+	return false;
+
+    ExecutableCache cache{key};
+    return cache.lookup(primaryUnit);
+}
+
+/*!
+ * Check whether any of the options that measure hbcxx (and the program it
+ * runs) were given.
+ */
+static bool isMeasuring()
+{
+    return Options::time() || !Options::trace().empty() || Options::rusage() ||
+           !Options::rusageFile().empty();
+}
+
+/*!
+ * Handle --hbcxx-time, --hbcxx-trace= and --hbcxx-rusage (at most once).
+ */
+static void reportMeasurements()
+{
+    static auto reported = bool{false};
+    if (reported || !isMeasuring())
+	return;
+
+    reported = true;
+    if (Options::time() || !Options::trace().empty())
+	hbcxx::writeTraceReport(Options::time(), Options::trace());
+    if (Options::rusage() || !Options::rusageFile().empty())
+	hbcxx::writeUsageReport(Options::rusage(), Options::rusageFile());
+}
+
+/*!
+ * Launch the program, replacing hbcxx if nothing needs to be cleaned up
+ * afterwards.
+ */
+static int launch(const CompilationUnit& unit,
+                  const std::list<std::string>& args, bool canReplace)
+{
+    auto launcher = makeLauncher();
+
+    // the program can only be measured if we wait for it
+    if (canReplace && !isMeasuring())
+	return hbcxx::propagate_status(launcher->replace(unit, args));
+
+    auto res = int{};
+    {
+	hbcxx::Span span{"run", unit.getExecutableFileName()};
+	res = launcher->launch(unit, args);
+    }
+
+    if (!canReplace && !Options::saveTemps()) {
+        auto fname = unit.getExecutableFileName();
+        file::remove(fname);
+	if (Options::verbose())
+            std::cerr << "hbcxx: removed " << fname << '\n';
+    }
+
+    reportMeasurements();
+    return hbcxx::propagate_status(res);
+}
+
+/*!
+ * Handle --hbcxx-cache-gc.
+ */
+static int collectGarbage()
+{
+    auto stats = StoreManager::Statistics{};
+    if (!StoreManager::collect(stats)) {
+	std::cerr << PACKAGE_NAME
+	          << ": cannot collect garbage (already running?)\n";
+	return 1;
+    }
 
-    auto primaryFile = handleArguments(args, toolset);
+    std::cout << PACKAGE_NAME << ": reclaimed " << stats.reclaimedBytes
+              << " bytes (" << stats.reclaimedFiles << " files), "
+              << stats.bytes << " bytes in use (" << stats.files
+              << " files)\n";
+    return 0;
+}
+
+static int run(std::list<std::string>& args)
+{
+    auto flags = std::list<std::string>{};
+    auto primaryFile = handleArguments(args, flags);
     if (primaryFile.empty())
 	return 1;
 
-    auto compilationUnits = std::list<CompilationUnit>{primaryFile};
+    // if nothing has changed since we last built this program then we can
+    // skip straight to launching it
+    Manifest manifest{primaryFile, flags};
+    auto cachedUnit = CompilationUnit{primaryFile};
+    if (lookupFromManifest(manifest, cachedUnit))
+	return launch(cachedUnit, args, true);
+
+    // only one invocation builds the program at a time. The others wait for
+    // it and then (usually) launch the executable it cached.
+    BuildLock lock{manifest.getLockFileName()};
+    if (lock.hasWaited() && lookupFromManifest(manifest, cachedUnit)) {
+	lock.release();
+	return launch(cachedUnit, args, true);
+    }
+
+    auto ppp = PrePreProcessor{};
+    auto toolset = Toolset{};
+    for (auto& flag : flags)
+	toolset.pushFlag(flag);
+
+    UnitRegistry registry{primaryFile};
+    auto& compilationUnits = registry.getUnits();
     ScopeExit cleanup{[&] {
         for (auto& unit : compilationUnits)
             unit.removeTemporaryFiles();
@@ -123,76 +247,114 @@ static int run(std::list<std::string>& args)
     // main loops (including the pre-pre-processor loop).
     hbcxx::block_signals();
 
+    // Compilation starts speculatively as soon as each unit has been
+    // pre-pre-processed. The pool must be destroyed (killing any outstanding
+    // jobs) before we remove the temporary files.
+    auto jobs = make_unique<JobPool>(Options::jobs());
+
     for (auto& unit : compilationUnits) {
 	hbcxx::poll_signals();
 
-	auto extraUnits = ppp.process(unit);
+	auto extraUnits = std::list<CompilationUnit>{};
+	{
+	    hbcxx::Span span{"pre-pre-process", unit.getInputFileName()};
+	    extraUnits = ppp.process(unit);
+	}
 	toolset.pushFlags(unit.getFlags());
+	{
+	    hbcxx::Span span{"speculate", unit.getInputFileName()};
+	    toolset.speculate(unit, *jobs);
+	}
 
 	// add any discovered units that are not already included
 	for (auto& extraUnit : extraUnits) {
-            auto i = std::find_if(std::begin(compilationUnits),
-                                  std::end(compilationUnits),
-                                  [&](const CompilationUnit& u) {
-                return u.getInputFileName() == extraUnit.getInputFileName();
-            });
-            if (i == std::end(compilationUnits)) {
-		if (Options::verbose())
-                    std::cerr << "hbcxx: auto-discovered: "
-                              << extraUnit.getInputFileName() << '\n';
-                compilationUnits.push_back(extraUnit);
-	    }
-        }
+	    auto added = registry.add(std::move(extraUnit));
+	    if (added && Options::verbose())
+		std::cerr << "hbcxx: auto-discovered: "
+		          << added->getInputFileName() << '\n';
+	}
     }
 
-    for (auto& unit : compilationUnits) {
-	hbcxx::poll_signals();
-	toolset.compile(unit);
-    }
+    if (Options::verbose())
+	std::cerr << "hbcxx: directory cache avoided "
+	          << DirectoryCache::getAvoidedCalls() << " stat calls (read "
+	          << DirectoryCache::getListingCount() << " directories)\n";
+
+    auto& primaryUnit = registry.getPrimary();
+    ExecutableCache cache{toolset, compilationUnits};
+    auto cached = cache.lookup(primaryUnit);
+
+    // the compiler is stamped before it runs (the pre-pre-processor has
+    // already stamped everything it read)
+    auto dependencies = ppp.getDependencies();
+    for (auto& program : toolset.getPrograms())
+	dependencies.push_back(hbcxx::stampFile(program));
+
+    if (!cached) {
+	{
+	    hbcxx::Span span{"compile"};
+	    toolset.compile(compilationUnits, *jobs);
+	    if (!jobs->wait())
+		throw ToolsetError{};
+	}
 
-    toolset.link(compilationUnits);
+	hbcxx::Span span{"link"};
+	cache.prepare(primaryUnit);
+	toolset.link(compilationUnits);
+	cached = cache.commit(primaryUnit,
+	                      toolset.getObjectFiles(compilationUnits));
+    }
+    jobs.reset();
     cleanup.runEarly();
 
+    if (cached)
+	manifest.update(cache.getKey(), dependencies);
+    lock.release();
+
+    // keep the store to a reasonable size (but not whilst we are building)
+    StoreManager::collectInBackground();
+
     if (!Options::executable().empty())
         return 0;
 
-    auto launcher = makeLauncher();
-    auto& primaryUnit = compilationUnits.front();
-
-    auto res = launcher->launch(primaryUnit, args);
-    if (!Options::saveTemps()) {
-        auto fname = primaryUnit.getExecutableFileName();
-        file::remove(fname);
-	if (Options::verbose())
-            std::cerr << "hbcxx: removed " << fname << '\n';
-    }
-    return hbcxx::propagate_status(res);
+    // an executable owned by the cache needs no cleanup so there is no
+    // reason for us to wait for it
+    return launch(primaryUnit, args, cached);
 }
 
 int main(int argc, const char* argv[])
 {
-    // we must process the options file before we process the command
-    // line because we want the things on the command line to supercede
-    // anything in the config file.
-    auto home = std::getenv("HOME");
-    auto rcfile = file::path{home ? home : ""} / ".hbcxx" / "hbcxxrc";
-    Options::parseOptionsFile(rcfile.native());
-
-    // arg0 gets special handling
-    Options::handleArg0(argv[0]);
-
-    // convert the arguments into an easily mutable form
-    auto privateArgs = std::list<std::string>{};
     auto args = std::list<std::string>{};
-    for (auto i=1; i<argc; i++) {
-	auto arg = std::string{argv[i]};
-	if (!Options::checkArgument(arg))
-	    args.push_back(std::move(arg));
+    {
+	hbcxx::Span span{"parse options"};
+
+	// we must process the options file before we process the command
+	// line because we want the things on the command line to supercede
+	// anything in the config file.
+	auto home = std::getenv("HOME");
+	auto rcfile = file::path{home ? home : ""} / ".hbcxx" / "hbcxxrc";
+	Options::parseOptionsFile(rcfile.native());
+
+	// arg0 gets special handling
+	Options::handleArg0(argv[0]);
+
+	// convert the arguments into an easily mutable form
+	for (auto i=1; i<argc; i++) {
+	    auto arg = std::string{argv[i]};
+	    if (!Options::checkArgument(arg))
+		args.push_back(std::move(arg));
+	}
     }
 
+    // report what we can even if the build fails
+    ScopeExit report{reportMeasurements};
+
     // command line tools can have *very* simple stop the world
     // exception handling models (or they could just call exit())
     try {
+	if (Options::cacheGc())
+	    return collectGarbage();
+
 	// launch the alternative program is HBCXX_SUBSTITUTE_ARG0 is set
 	if (std::getenv("HBCXX_SUBSTITUTE_ARG0"))
             return exec_wrapper(args);
@@ -74,6 +74,44 @@ C shlex(std::string s)
     return result;
 }
 
+/*!
+ * Join tokens to form a command line that shlex() can split again.
+ *
+ * Tokens are only quoted if they contain characters that are special to
+ * the shell so that simple commands remain easy to read.
+ */
+template<class C>
+std::string shjoin(const C& tokens)
+{
+    auto result = std::string{};
+
+    for (const auto& token : tokens) {
+	if (!result.empty())
+	    result += ' ';
+
+	auto safe = !token.empty();
+	for (auto c : token)
+	    if (!isalnum(c) && std::string{"+-_./=:,@%"}.find(c) == std::string::npos)
+		safe = false;
+
+	if (safe) {
+	    result += token;
+	    continue;
+	}
+
+	result += '\'';
+	for (auto c : token) {
+	    if (c == '\'')
+		result += "'\\''";
+	    else
+		result += c;
+	}
+	result += '\'';
+    }
+
+    return result;
+}
+
 }; // namespace hpcxx
 
 #endif // HPCXX_STRING_H_
@@ -20,10 +20,13 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 
 #include <cassert>
+#include <cctype>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
@@ -34,38 +37,34 @@
 #include <system_error>
 #include <vector>
 
-static int forkExecAndWait(const char *path, const char* const argv[])
-{
-    using namespace hbcxx;
-
-    block_signals();
-
-    auto childPid = fork();
-    if (-1 == childPid)
-	return -1;
-
-    if (0 == childPid) {
-        // restore normal signal handling within the child
-	unblock_signals();
+#include "trace.h"
 
-        (void) execv(path, const_cast<char**>(argv));
+extern char** environ;
 
-	// ::execv returns only on error (and having forked we've no
-	// longer got anyone to throw an exception at
-	std::exit(127);
-    }
-
-    auto res = int{};
-    auto waitPid = wait(&res);
-    if (-1 == waitPid)
-	return -1;
-
-    return res;
+const std::string& hbcxx::hostName()
+{
+    static auto name = std::string{};
+    if (!name.empty())
+	return name;
+
+    char buf[256] = {};
+    if (0 != gethostname(buf, sizeof(buf) - 1) || '\0' == buf[0])
+	name = "localhost";
+    else
+	name = buf;
+
+    for (auto& c : name)
+	if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' &&
+	    c != '-')
+	    c = '_';
+
+    return name;
 }
 
 const std::string& hbcxx::unique(void)
 {
-    static auto uniq = std::string{"-hbcxx-"} + std::to_string(getpid());
+    static auto uniq = std::string{"-hbcxx-"} + hostName() + '-' +
+                       std::to_string(getpid());
     return uniq;
 }
 
@@ -73,25 +72,90 @@ int hbcxx::system(const std::string& command)
 {
     block_signals();
 
-    auto childPid = fork();
-    if (-1 == childPid)
+    auto pid = spawn("/bin/sh", {"sh", "-c", command});
+    if (-1 == pid)
 	return -1;
 
-    if (0 == childPid) {
-        // restore normal signal handling within the child
-	unblock_signals();
-	std::exit(propagate_status(::system(command.c_str())));
-    }
-
     auto res = int{};
-    auto waitPid = wait(&res);
-    if (-1 == waitPid)
+    if (-1 == reap(pid, res))
 	return -1;
 
     hbcxx::poll_signals();
     return res;
 }
 
+pid_t hbcxx::spawn(const std::string& path, const std::list<std::string>& args,
+                   int input, const std::string& errorLog,
+                   bool newGroup)
+{
+    // prepare the arguments before spawning whilst it is easier for us to
+    // handle the errors
+    auto argv = std::vector<const char*>{};
+    for (auto& arg : args)
+	argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    (void) posix_spawn_file_actions_init(&actions);
+    (void) posix_spawnattr_init(&attr);
+
+    if (-1 != input)
+	(void) posix_spawn_file_actions_adddup2(&actions, input, 0);
+    if (!errorLog.empty())
+	(void) posix_spawn_file_actions_addopen(&actions, 2, errorLog.c_str(),
+	                                        O_WRONLY | O_CREAT | O_TRUNC,
+	                                        0600);
+
+    // restore normal signal handling within the child
+    sigset_t mask, defaults;
+    (void) sigprocmask(SIG_SETMASK, nullptr, &mask);
+    (void) sigdelset(&mask, SIGINT);
+    (void) sigdelset(&mask, SIGQUIT);
+    (void) sigemptyset(&defaults);
+    (void) sigaddset(&defaults, SIGPIPE);
+    (void) posix_spawnattr_setsigmask(&attr, &mask);
+    (void) posix_spawnattr_setsigdefault(&attr, &defaults);
+    (void) posix_spawnattr_setpgroup(&attr, 0);
+    (void) posix_spawnattr_setflags(&attr,
+                                    POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF |
+                                    (newGroup ? POSIX_SPAWN_SETPGROUP : 0));
+
+    pid_t pid;
+    auto err = posix_spawn(&pid, path.c_str(), &actions, &attr,
+                           const_cast<char**>(argv.data()), environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (0 != err) {
+	errno = err;
+	return -1;
+    }
+
+    traceProcessStart(pid, args);
+    return pid;
+}
+
+pid_t hbcxx::reap(pid_t pid, int& res, bool poll)
+{
+    // wait4() rather than waitpid() so we can report the resources used
+    struct rusage usage;
+    pid_t waitPid;
+    do {
+	waitPid = ::wait4(pid, &res, poll ? WNOHANG : 0, &usage);
+    } while (-1 == waitPid && EINTR == errno);
+
+    if (waitPid > 0)
+	traceProcessEnd(waitPid, res, usage);
+    return waitPid;
+}
+
+pid_t hbcxx::wait(int& res, bool poll)
+{
+    return reap(-1, res, poll);
+}
+
 int hbcxx::system(const std::string& command, std::unique_ptr<std::stringstream>& output)
 {
     FILE *p = popen(command.c_str(), "r");
@@ -110,15 +174,17 @@ int hbcxx::system(const std::string& command, std::unique_ptr<std::stringstream>
 
 int hbcxx::system(const std::string& command, const std::list<std::string>& args)
 {
-    // prepare the arguments for ::execv before forking whilst it is easier
-    // for us to handle the errors.
-    auto path = command.c_str();
-    auto argv = std::vector<const char*>{};
-    for (auto& arg : args)
-	argv.push_back(arg.c_str());
-    argv.push_back(nullptr);
+    block_signals();
 
-    return forkExecAndWait(path, argv.data());
+    auto pid = spawn(command, args);
+    if (-1 == pid)
+	return -1;
+
+    auto res = int{};
+    if (-1 == reap(pid, res))
+	return -1;
+
+    return res;
 }
 
 void hbcxx::exec(const std::string& command,
@@ -14,6 +14,8 @@
 #ifndef HBCXX_SYSTEM_H_
 #define HBCXX_SYSTEM_H_
 
+#include <sys/types.h>
+
 #include <list>
 #include <string>
 #include <memory>
@@ -21,8 +23,17 @@
 
 namespace hbcxx {
 
+/*!
+ * Get the name of this host (made safe for use in a file name).
+ */
+const std::string& hostName();
+
 /*!
  * Get a string unique(ish) to this invokation of hbcxx.
+ *
+ * The string is "-hbcxx-<host>-<pid>" so that temporary files can be
+ * traced back to their process even when the store is shared between
+ * hosts.
  */
 const std::string& unique(void);
 
@@ -32,6 +43,44 @@ const std::string& unique(void);
  */
 int system(const std::string& command);
 
+/*!
+ * Start a program without waiting for it to complete.
+ *
+ * The program is started directly using posix_spawn() rather than via the
+ * shell. As with ::execv() the path is not searched for in the PATH and
+ * args must include argv[0]. Normal signal handling is restored within
+ * the child.
+ *
+ * \param input if not -1, a descriptor (such as the read end of a pipe)
+ *              that becomes the program's standard input
+ * \param errorLog if not empty, the file to which the program's standard
+ *                 error is redirected
+ * \param newGroup if true, the child leads a new process group (so that it
+ *                 and any children of its own can be killed together)
+ * \returns the process id of the child or -1 on error
+ */
+pid_t spawn(const std::string& path, const std::list<std::string>& args,
+            int input = -1,
+            const std::string& errorLog = std::string{},
+            bool newGroup = false);
+
+/*!
+ * Wait for a specific child to terminate.
+ *
+ * \returns pid (with its status written to res), 0 if poll is set and the
+ *          child has not terminated yet or -1 on error
+ */
+pid_t reap(pid_t pid, int& res, bool poll = false);
+
+/*!
+ * Wait for any child to terminate.
+ *
+ * \returns the process id of the child (with its status written to res),
+ *          0 if poll is set and no child has terminated yet or -1 if
+ *          there are no children to wait for
+ */
+pid_t wait(int& res, bool poll = false);
+
 /*!
  * A std::system() workalike that captures the subprocess' standard output.
  *
@@ -44,11 +93,8 @@ int system(const std::string& command, std::unique_ptr<std::stringstream>& io);
 /*!
  * A std::system() workalike without shell argument parsing.
  *
- * \todo This code currently requires a list be passed in. It would be better
- *       to use a template function here. However we do not want to call
- *       ::execv from the header (would require too many raw C headers).
- *       However we could prepare a vector<const char *> and pass that to
- *       a non-template helper function.
+ * As with hbcxx::spawn() the command is not searched for in the PATH and
+ * args must include argv[0].
  */
 int system(const std::string& command, const std::list<std::string>& args);
 
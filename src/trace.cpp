@@ -0,0 +1,269 @@
+/*
+ * trace.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "trace.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "string.h"
+
+namespace {
+
+struct Event {
+    std::string name;
+    std::string detail;
+    std::string phase; //!< the innermost span open when a process started
+    double start;      //!< microseconds since hbcxx started
+    double duration;   //!< microseconds
+    pid_t lane;        //!< hbcxx itself or the child process
+    int status;        //!< as reported by wait4() (processes only)
+    struct rusage usage;
+};
+
+const auto origin = std::chrono::steady_clock::now();
+
+double now()
+{
+    auto elapsed = std::chrono::steady_clock::now() - origin;
+    return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+std::vector<Event>& events()
+{
+    static std::vector<Event> events;
+    return events;
+}
+
+std::map<pid_t, Event>& processes()
+{
+    static std::map<pid_t, Event> processes;
+    return processes;
+}
+
+std::vector<std::string>& openSpans()
+{
+    static std::vector<std::string> spans;
+    return spans;
+}
+
+double milliseconds(const struct timeval& tv)
+{
+    return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+std::string quote(const std::string& s)
+{
+    auto quoted = std::string{"\""};
+    for (auto c : s) {
+	switch (c) {
+	case '"':
+	    quoted += "\\\"";
+	    break;
+	case '\\':
+	    quoted += "\\\\";
+	    break;
+	case '\n':
+	    quoted += "\\n";
+	    break;
+	case '\t':
+	    quoted += "\\t";
+	    break;
+	default:
+	    if (static_cast<unsigned char>(c) < 0x20) {
+		char escape[8];
+		std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+		quoted += escape;
+	    } else {
+		quoted += c;
+	    }
+	}
+    }
+    return quoted + '"';
+}
+
+} // anonymous namespace
+
+hbcxx::Span::Span(std::string name, std::string detail)
+    : _name{std::move(name)}
+    , _detail{std::move(detail)}
+    , _start{now()}
+{
+    openSpans().push_back(_name);
+}
+
+hbcxx::Span::~Span()
+{
+    openSpans().pop_back();
+    events().push_back(Event{std::move(_name), std::move(_detail),
+                             std::string{}, _start, now() - _start, getpid(),
+                             0, rusage{}});
+}
+
+void hbcxx::traceProcessStart(pid_t pid, const std::list<std::string>& args)
+{
+    auto name = args.empty() ? std::string{} : args.front();
+    auto slash = name.rfind('/');
+    if (slash != std::string::npos)
+	name.erase(0, slash + 1);
+
+    auto phase = openSpans().empty() ? std::string{} : openSpans().back();
+    processes().erase(pid);
+    processes().emplace(pid, Event{name, shjoin(args), phase, now(), 0, pid,
+                                   0, rusage{}});
+}
+
+void hbcxx::traceProcessEnd(pid_t pid, int status, const struct rusage& usage)
+{
+    auto i = processes().find(pid);
+    if (i == processes().end())
+	return;
+
+    auto event = std::move(i->second);
+    processes().erase(i);
+    event.duration = now() - event.start;
+    event.status = status;
+    event.usage = usage;
+    events().push_back(std::move(event));
+}
+
+void hbcxx::writeTraceReport(bool summary, const std::string& fname)
+{
+    if (summary) {
+	// phases are listed in the order they first started
+	auto order = std::vector<std::string>{};
+	auto totals = std::map<std::string, std::pair<double, unsigned>>{};
+	auto sorted = events();
+	std::stable_sort(sorted.begin(), sorted.end(),
+	                 [](const Event& a, const Event& b) {
+	    return a.start < b.start;
+	});
+	for (auto& event : sorted) {
+	    auto& total = totals[event.name];
+	    if (0 == total.second++)
+		order.push_back(event.name);
+	    total.first += event.duration;
+	}
+
+	std::cerr << std::fixed << std::setprecision(1);
+	for (auto& name : order) {
+	    auto& total = totals[name];
+	    std::cerr << "hbcxx: time: " << std::left << std::setw(20) << name
+	              << std::right << std::setw(10) << total.first / 1000
+	              << " ms";
+	    if (total.second > 1)
+		std::cerr << " (" << total.second << " times)";
+	    std::cerr << '\n';
+	}
+	std::cerr << "hbcxx: time: " << std::left << std::setw(20) << "total"
+	          << std::right << std::setw(10) << now() / 1000 << " ms\n";
+	std::cerr.unsetf(std::ios::floatfield | std::ios::adjustfield);
+    }
+
+    if (fname.empty())
+	return;
+
+    std::ostringstream trace;
+    trace << std::fixed << std::setprecision(3);
+    trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    auto pid = getpid();
+    trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+          << ",\"tid\":" << pid << ",\"args\":{\"name\":\"hbcxx\"}}";
+    for (auto& event : events()) {
+	if (event.lane != pid)
+	    trace << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+	          << pid << ",\"tid\":" << event.lane
+	          << ",\"args\":{\"name\":"
+	          << quote(event.name + " [" + std::to_string(event.lane) + "]")
+	          << "}}";
+	trace << ",\n{\"name\":" << quote(event.name)
+	      << ",\"cat\":\"" << (event.lane == pid ? "hbcxx" : "process")
+	      << "\",\"ph\":\"X\",\"ts\":" << event.start
+	      << ",\"dur\":" << event.duration << ",\"pid\":" << pid
+	      << ",\"tid\":" << event.lane;
+	if (!event.detail.empty())
+	    trace << ",\"args\":{\"detail\":" << quote(event.detail) << '}';
+	trace << '}';
+    }
+    trace << "\n]}\n";
+
+    std::ofstream out{fname};
+    out << trace.str();
+    if (!out.good())
+	std::cerr << "hbcxx: warning: cannot write trace to " << fname << '\n';
+}
+
+void hbcxx::writeUsageReport(bool summary, const std::string& fname)
+{
+    std::ostringstream records;
+    records << std::fixed << std::setprecision(3);
+    auto pid = getpid();
+    auto timestamp = std::time(nullptr);
+
+    for (auto& event : events()) {
+	if (event.lane == pid)
+	    continue;
+
+	auto& usage = event.usage;
+	auto exitStatus = WIFEXITED(event.status) ? WEXITSTATUS(event.status)
+	                                          : -1;
+	if (summary)
+	    std::cerr << std::fixed << std::setprecision(1)
+	              << "hbcxx: rusage: " << event.name << " (" << event.phase
+	              << "): wall " << event.duration / 1000 << " ms, user "
+	              << milliseconds(usage.ru_utime) << " ms, sys "
+	              << milliseconds(usage.ru_stime) << " ms, max rss "
+	              << usage.ru_maxrss << " KB, faults "
+	              << usage.ru_majflt << " major / " << usage.ru_minflt
+	              << " minor\n";
+
+	records << "{\"time\":" << timestamp << ",\"hbcxx\":" << pid
+	        << ",\"pid\":" << event.lane
+	        << ",\"name\":" << quote(event.name)
+	        << ",\"phase\":" << quote(event.phase)
+	        << ",\"command\":" << quote(event.detail)
+	        << ",\"status\":" << exitStatus
+	        << ",\"wall_ms\":" << event.duration / 1000
+	        << ",\"user_ms\":" << milliseconds(usage.ru_utime)
+	        << ",\"sys_ms\":" << milliseconds(usage.ru_stime)
+	        << ",\"maxrss_kb\":" << usage.ru_maxrss
+	        << ",\"majflt\":" << usage.ru_majflt
+	        << ",\"minflt\":" << usage.ru_minflt << "}\n";
+    }
+    std::cerr.unsetf(std::ios::floatfield);
+
+    if (fname.empty())
+	return;
+
+    // records are appended so that a single file can gather the usage of
+    // many runs
+    std::ofstream out{fname, std::ios::app};
+    out << records.str();
+    if (!out.good())
+	std::cerr << "hbcxx: warning: cannot write resource usage to " << fname
+	          << '\n';
+}
@@ -0,0 +1,90 @@
+/*
+ * trace.h
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HBCXX_TRACE_H_
+#define HBCXX_TRACE_H_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include <list>
+#include <string>
+
+namespace hbcxx {
+
+/*!
+ * Record how long a phase of hbcxx took.
+ *
+ * The span starts when it is constructed and ends when it is destroyed.
+ * Spans are always recorded (there are only a few dozen of them) but are
+ * only reported if requested (see writeTraceReport()).
+ *
+ * Example:
+ *
+ *     Span span{"link"};
+ */
+class Span {
+public:
+    explicit Span(std::string name, std::string detail = std::string{});
+    ~Span();
+
+private:
+    Span(const Span&);
+    Span& operator=(const Span&);
+
+    std::string _name;
+    std::string _detail;
+    double _start;
+};
+
+/*!
+ * Record that a child process has started.
+ *
+ * This is called by hbcxx::spawn() so every child is recorded.
+ */
+void traceProcessStart(pid_t pid, const std::list<std::string>& args);
+
+/*!
+ * Record that a child process has terminated.
+ *
+ * This is called by hbcxx::reap() so every child is recorded.
+ *
+ * \param status the status reported by wait4()
+ * \param usage the resources used by the child
+ */
+void traceProcessEnd(pid_t pid, int status, const struct rusage& usage);
+
+/*!
+ * Report the spans recorded so far.
+ *
+ * \param summary if set, print the total time spent in each phase (and by
+ *                each program that was run) to stderr
+ * \param fname if not empty, write the spans in Chrome's trace event format
+ *              (one lane for hbcxx and one for each child process)
+ */
+void writeTraceReport(bool summary, const std::string& fname);
+
+/*!
+ * Report the resources used by each child process.
+ *
+ * Each child is labelled with the span that was open when it started (for
+ * example "compile", "link" or "run").
+ *
+ * \param summary if set, print the usage of each child to stderr
+ * \param fname if not empty, append one JSON object per child to fname
+ */
+void writeUsageReport(bool summary, const std::string& fname);
+
+}; // namespace hbcxx
+
+#endif // HBCXX_TRACE_H_
@@ -0,0 +1,26 @@
+#!/usr/bin/env hbcxx
+
+/*
+ * canonical.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file canonical.cpp
+ *
+ * Unit test for discovering the same source file via different paths
+ */
+
+#include "empty.h"
+#include "../tests/empty.h"
+
+// both includes lead to the same source file (which provides main()). If
+// it were compiled twice the link would fail.
@@ -0,0 +1,64 @@
+#!/usr/bin/env hbcxx
+
+/*
+ * dircache.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file dircache.cpp
+ *
+ * Unit test for DirectoryCache.
+ */
+
+#include "../src/DirectoryCache.h"
+#include "../src/filesystem.h"
+#include "../src/system.h"
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace file = boost::filesystem;
+
+int main()
+{
+    auto dir = file::temp_directory_path() /
+               (std::string{"dircache"} + hbcxx::unique());
+    file::create_directories(dir / "subdir");
+    hbcxx::touch((dir / "file.cpp").string());
+    file::create_symlink(dir / "file.cpp", dir / "link.cpp");
+    file::create_symlink(dir / "nowhere.cpp", dir / "dangling.cpp");
+
+    auto check = [&](const file::path& path) {
+	auto expected = file::exists(path);
+	auto actual = DirectoryCache::exists(path.string());
+	std::cout << path.string() << ": " << actual << '\n';
+	assert(expected == actual);
+    };
+
+    for (auto name : { "file.cpp", "file.cc", "link.cpp", "dangling.cpp",
+                       "subdir", "subdir/", ".", "..",
+                       "missing/file.cpp", "file.cpp/file.cpp" })
+	check(dir / name);
+
+    // files that appear after a directory has been listed are not seen
+    hbcxx::touch((dir / "file.c").string());
+    assert(!DirectoryCache::exists((dir / "file.c").string()));
+
+    assert(DirectoryCache::getAvoidedCalls() > 0);
+    assert(DirectoryCache::getListingCount() >= 3);
+
+    file::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#!/usr/bin/env hbcxx
+
+/*
+ * hash.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file hash.cpp
+ *
+ * Unit test for Hash (using the SHA-256 examples from FIPS 180-4).
+ */
+
+#include "../src/hash.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+using namespace hbcxx;
+
+static std::string sha256(const std::string& message, std::size_t chunk)
+{
+    auto hash = Hash{};
+    for (std::size_t i = 0; i < message.size(); i += chunk)
+	hash.update(message.data() + i, std::min(chunk, message.size() - i));
+    return hash.hex();
+}
+
+static bool check(const std::string& message, const char* expected)
+{
+    // feeding the message in pieces must not change the digest
+    for (auto chunk : { std::size_t{1}, std::size_t{63}, std::size_t{64},
+                        std::size_t{65}, std::size_t{1000000} }) {
+	auto actual = sha256(message, chunk);
+	if (actual != expected) {
+	    std::cerr << "sha256 of " << message.size() << " bytes (in "
+	              << chunk << " byte pieces) is " << actual << '\n'
+	              << "                         expected " << expected
+	              << '\n';
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main()
+{
+    auto ok = true;
+
+    ok &= check("",
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    ok &= check("abc",
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    // 448 bits: the padding no longer fits in the first block
+    ok &= check("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // 896 bits: two full blocks, with the padding in a third
+    ok &= check("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+                "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+        "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+
+    ok &= check(std::string(1000000, 'a'),
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    // taking the digest must not disturb later updates
+    auto hash = Hash{};
+    hash.update("ab", 2);
+    (void) hash.hex();
+    hash.update("c", 1);
+    ok &= hash.hex() ==
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+    // strings are length prefixed so they cannot run together
+    ok &= Hash{}.update(std::string{"ab"}).update(std::string{"c"}).hex() !=
+          Hash{}.update(std::string{"a"}).update(std::string{"bc"}).hex();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#!/usr/bin/env hbcxx
+
+/*
+ * scanner.cpp
+ *
+ * Part of hbcxx - executable C++ source code
+ *
+ * Copyright (C) 2014 Daniel Thompson <daniel@redfelineninja.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*!
+ * \file scanner.cpp
+ *
+ * Unit test for DirectiveScanner.
+ *
+ * Checks the scanner against the regular expressions that the
+ * pre-pre-processor used before the scanner was written. Double quotes
+ * within the samples are written as \x22 so that the samples are not
+ * mistaken for directives when this file is itself pre-pre-processed.
+ */
+
+#include "../src/DirectiveScanner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include <boost/regex.hpp>
+
+namespace re = boost;
+
+static const char* samples[] = {
+    "",
+    "int main() { return 0; }",
+    "#!/usr/bin/env hbcxx",
+    "  \t#!/usr/bin/env hbcxx",
+    "//#! -O2 -g",
+    "//#!-O2",
+    "  //#! -lfoo",
+    "//#! cxx: clang++",
+    "//#!private:-DPRIVATE",
+    "//#! pkgconfig : gtk+-3.0 >= 3.0",
+    "//#!   :",
+    "//#! /usr/bin/env hbcxx",
+    "//#! frobnicate",
+    "//#!",
+    "int x; //#! -DX",
+    "puts(\x22//#! not a directive\x22);",
+    "puts(\x22\x22); //#! -DY",
+    "//#! -DA //#! -DB",
+    "//#! name: value //#! -DB",
+    "//#! -DA //#! name: value",
+    "//#! unknown //#! /bin/sh",
+    "/#! -DX",
+    "//# -DX",
+    "// #! -DX",
+    "#include \x22local.h\x22",
+    "  #  include\t\x22local.h\x22 // comment",
+    "#include\x22local.h\x22",
+    "#include \x22unterminated.h",
+    "#include <vector>",
+    "#include<vector>",
+    "# include <boost/regex.hpp> // <comment>",
+    "#include <a> \x22quoted\x22 <b>",
+    "#include <no-close",
+    "#includes <vector>",
+    "#define include <vector>",
+    "#pragma once",
+    "#",
+};
+
+static void check(const std::string& origline)
+{
+    auto rawHashBangRegex = re::regex{"^([ \t]*)(#!)"};
+    auto hashBangRegex = re::regex{"^(.*)//#![ \t]*(.*)$"};
+    auto interpreterRegex = re::regex{"//#![ \t]*/"};
+    auto flagsRegex = re::regex{"//#![ \t]*(-.*)$"};
+    auto directiveRegex = re::regex{"//#![ \t]*([a-zA-Z_]*)[ \t]*:[ \t]*(.*)$"};
+    auto localIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*\"([^\"]*)\""};
+    auto systemIncludeRegex = re::regex{"^[ \t]*#[ \t]*include[ \t][ \t]*<([^\"]*)>"};
+    auto match = re::smatch{};
+
+    DirectiveScanner scanner{origline.data(),
+                             origline.data() + origline.size()};
+    auto scanned = ScannedLine{};
+    if (!scanner.next(scanned)) {
+	// lines without a '#' are never reported
+	assert(std::string::npos == origline.find('#'));
+	return;
+    }
+    assert(1 == scanned.number);
+    assert(origline == scanned.original.str());
+
+    auto line = re::regex_replace(origline, rawHashBangRegex, "$1//$2");
+    if (line == origline) {
+	assert(ScannedLine::npos == scanned.rewriteOffset);
+    } else {
+	auto rewritten = origline;
+	rewritten.insert(scanned.rewriteOffset, "//");
+	assert(line == rewritten);
+    }
+
+    auto hashBang = re::regex_search(line, match, hashBangRegex);
+    if (hashBang) {
+	auto leadIn = std::string{match[1]};
+	if (std::count(leadIn.begin(), leadIn.end(), '"') & 1)
+	    hashBang = false;
+    }
+    assert(hashBang == scanned.hasHashBang);
+    if (hashBang) {
+	assert(std::string{match[1]}.size() + 1 == scanned.hashBangColumn);
+	assert(match[2] == scanned.hashBangText.str());
+    }
+
+    auto flags = re::regex_search(line, match, flagsRegex);
+    assert(flags == scanned.hasFlags);
+    if (flags)
+	assert(match[1] == scanned.flags.str());
+
+    auto directive = re::regex_search(line, match, directiveRegex);
+    assert(directive == scanned.hasDirective);
+    if (directive) {
+	assert(match[1] == scanned.directiveName.str());
+	assert(match[2] == scanned.directiveValue.str());
+    }
+
+    assert(re::regex_search(line, interpreterRegex) == scanned.hasInterpreter);
+
+    auto local = re::regex_search(line, match, localIncludeRegex);
+    assert(local == (ScannedLine::LocalInclude == scanned.include));
+    if (local)
+	assert(match[1] == scanned.includeFile.str());
+
+    auto system = re::regex_search(line, match, systemIncludeRegex);
+    assert(system == (ScannedLine::SystemInclude == scanned.include));
+    if (system)
+	assert(match[1] == scanned.includeFile.str());
+
+    assert(!scanner.next(scanned));
+}
+
+int main()
+{
+    for (auto sample : samples)
+	check(sample);
+
+    // check that line numbers are tracked across lines that are skipped
+    auto text = std::string{"one\ntwo\n#three\nfour\n\n#six"};
+    DirectiveScanner scanner{text.data(), text.data() + text.size()};
+    auto line = ScannedLine{};
+    assert(scanner.next(line));
+    assert(3 == line.number);
+    assert("#three" == line.original.str());
+    assert(scanner.next(line));
+    assert(6 == line.number);
+    assert("#six" == line.original.str());
+    assert(!scanner.next(line));
+
+    return 0;
+}
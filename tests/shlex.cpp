@@ -64,5 +64,10 @@ int main()
     assert(4 == vectorOfTokens.size());
     show(vectorOfTokens);
 
+    tokens = std::list<std::string>{"g++", "-DX=\"a b\"", "it's", ""};
+    assert(shlex(shjoin(tokens)).size() == 3); // shlex drops empty tokens
+    assert(shlex(shjoin(tokens)).back() == "it's");
+    assert(shjoin(std::list<std::string>{"g++", "-O2"}) == "g++ -O2");
+
     return 0;
 }
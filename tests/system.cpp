@@ -22,7 +22,11 @@
 
 #include "../src/system.h"
 
+#include <unistd.h>
+
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -41,5 +45,28 @@ int main()
 	std::cout << line << std::endl;
     }
 
+    // run a program without the shell, feeding it input and capturing
+    // its standard error
+    int fds[2];
+    assert(0 == pipe(fds));
+    assert(6 == write(fds[1], "hello\n", 6));
+    (void) close(fds[1]);
+    auto log = std::string{"/tmp/system"} + unique() + ".log";
+    auto pid = spawn("/bin/sh", {"sh", "-c", "cat >&2; exit 3"}, fds[0],
+                     log);
+    (void) close(fds[0]);
+    assert(-1 != pid);
+    auto status = int{};
+    assert(pid == reap(pid, status));
+    assert(3 == propagate_status(status));
+
+    std::ifstream in{log};
+    std::getline(in, line);
+    assert("hello" == line);
+    (void) std::remove(log.c_str());
+
+    assert(0 == system("/bin/true", {"true"}));
+    assert(-1 == spawn("/does/not/exist", {"exist"}));
+
     return res;
 }